@@ -14,8 +14,10 @@
 #ifndef TACHYMETER_CSV_REPORTER_HPP
 #define TACHYMETER_CSV_REPORTER_HPP
 
+#include <cmath>
 #include <iostream>
 #include <fstream>
+#include <string>
 
 #include "reporter.hpp"
 
@@ -31,11 +33,111 @@ public:
   { }
   virtual ~CSV_reporter() = default;
   void report(result_sequence const &results, std::string const &name) override;
+  void info(std::string const &key, std::string const &value) override;
 private:
   std::ostream *os;
   const char* out_dir;
+  std::string infos;
 };
 
+namespace detail
+{
+
+inline
+void
+write_CSV_header(std::ostream      &out,
+                 std::string const &name,
+                 std::string const &infos,
+                 measurement const &layout)
+{
+  out << "# " << name << (layout.cold_cache ? " (cold cache)" : "") << '\n'
+      << infos
+      << "#size";
+  for (std::size_t i = 1; i < layout.num_parameters; ++i)
+  {
+    out << ",size" << i + 1;
+  }
+  out << ",lo_q,median,agerage,hi_q,runs,batch,p90,p99,p99.9,max,"
+         "median_lo,median_hi";
+  for (std::size_t i = 0; layout.has_counters && i != num_counters; ++i)
+  {
+    out << ',' << counter_name(static_cast<counter>(i));
+  }
+  if (layout.has_allocations) out << ",allocs,deallocs,bytes";
+  if (layout.threads != 0) out << ",threads,ops/s,efficiency";
+  if (layout.has_throughput) out << ",items/s,bytes/s,GB/s";
+  if (layout.has_warmup) out << ",warmup,warmup_median";
+  if (layout.has_speedup) out << ",speedup,speedup_lo,speedup_hi";
+  out << '\n';
+}
+
+inline
+void
+write_CSV_row(std::ostream &out, measurement const &m)
+{
+  out << m.data_size;
+  for (std::size_t i = 1; i < m.num_parameters; ++i)
+  {
+    out << ',' << m.parameters[i];
+  }
+  out << ',' << m.lower_quartile << ',' << m.median << ','
+      << m.average << ',' << m.upper_quartile << ',' << m.num_runs << ','
+      << m.batch_size << ',' << m.percentile_90 << ',' << m.percentile_99 << ','
+      << m.percentile_99_9 << ',' << m.maximum << ',' << m.median_low << ','
+      << m.median_high;
+  for (std::size_t i = 0; m.has_counters && i != num_counters; ++i)
+  {
+    out << ',';
+    if (m.counters[i] == counter_unavailable) out << "n/a";
+    else out << m.counters[i];
+  }
+  if (m.has_allocations)
+  {
+    for (auto v : { m.allocations_per_call,
+                    m.deallocations_per_call,
+                    m.bytes_per_call })
+    {
+      out << ',';
+      if (std::isnan(v)) out << "n/a";
+      else out << v;
+    }
+  }
+  if (m.threads != 0)
+  {
+    out << ',' << m.threads << ',' << m.ops_per_second << ','
+        << m.scaling_efficiency;
+  }
+  if (m.has_throughput)
+  {
+    for (auto v : { m.items_per_second,
+                    m.bytes_per_second,
+                    m.bytes_per_second / 1e9 })
+    {
+      out << ',';
+      if (std::isnan(v)) out << "n/a";
+      else out << v;
+    }
+  }
+  if (m.has_warmup) out << ',' << m.warmup_runs << ',' << m.warmup_median;
+  if (m.has_speedup)
+  {
+    out << ',' << m.speedup << ',' << m.speedup_low << ',' << m.speedup_high;
+  }
+  out << '\n';
+  if (m.has_warmup && !m.warmup_settled)
+  {
+    out << "# warning: timings at size " << m.data_size
+        << " did not settle during warmup\n";
+  }
+  if (m.near_resolution)
+  {
+    out << "# warning: median at size " << m.data_size
+        << " is within a few ticks of the clock resolution\n";
+  }
+}
+
+}
+
 inline
 void
 CSV_reporter::report(tachymeter::result_sequence const &results,
@@ -46,21 +148,27 @@ CSV_reporter::report(tachymeter::result_sequence const &results,
   std::ofstream out;
   if (out_dir) out.open(out_dir + "/"s + name);
 
-  if (os) *os << "# " << name << "\n#size,lo_q,median,agerage,hi_q,runs\n";
+  // Optional column groups are present for all rows, or none.
+  auto const layout = results.empty() ? measurement{ } : results.front();
+
+  if (os) detail::write_CSV_header(*os, name, { }, layout);
 
-  out << "# " << name << "\n#size,lo_q,median,agerage,hi_q,runs\n";
+  detail::write_CSV_header(out, name, infos, layout);
   for (auto const &m : results)
   {
-    if (os)
-    {
-      *os << m.data_size << ',' << m.lower_quartile << ',' << m.median << ','
-          << m.average << ',' << m.upper_quartile << ',' << m.num_runs << '\n';
-    }
-    out << m.data_size << ',' << m.lower_quartile << ',' << m.median << ','
-        << m.average << ',' << m.upper_quartile << ',' << m.num_runs << '\n';
+    if (os) detail::write_CSV_row(*os, m);
+    detail::write_CSV_row(out, m);
   }
 }
 
+inline
+void
+CSV_reporter::info(std::string const &key, std::string const &value)
+{
+  auto const line = "# " + key + ": " + value + '\n';
+  if (os) *os << line;
+  infos += line;
+}
 
 }
 #endif //TACHYMETER_CSV_REPORTER_HPP
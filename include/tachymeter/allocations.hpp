@@ -0,0 +1,162 @@
+/*
+ * Tachymeter C++ micro benchmark
+ *
+ * Copyright Björn Fahller 2015
+ *
+ *  Use, modification and distribution is subject to the
+ *  Boost Software License, Version 1.0. (See accompanying
+ *  file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ *
+ * Project home: https://github.com/rollbear/tachymeter
+ */
+
+#ifndef TACHYMETER_ALLOCATIONS_HPP
+#define TACHYMETER_ALLOCATIONS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tachymeter
+{
+
+struct allocation_stats
+{
+  uint64_t allocations;
+  uint64_t deallocations;
+  uint64_t bytes;
+};
+
+inline
+allocation_stats operator-(allocation_stats const &lh,
+                           allocation_stats const &rh)
+{
+  return { lh.allocations - rh.allocations,
+           lh.deallocations - rh.deallocations,
+           lh.bytes - rh.bytes };
+}
+
+inline
+allocation_stats &operator+=(allocation_stats &lh, allocation_stats const &rh)
+{
+  lh.allocations += rh.allocations;
+  lh.deallocations += rh.deallocations;
+  lh.bytes += rh.bytes;
+  return lh;
+}
+
+// Running totals of the global operator new/delete calls made by the calling
+// thread. Only counted when the hooks are installed, see below.
+inline allocation_stats &thread_allocation_stats()
+{
+  static thread_local allocation_stats stats{ };
+  return stats;
+}
+
+inline bool &allocation_hooks_installed()
+{
+  static bool installed = false;
+  return installed;
+}
+
+}
+
+#endif //TACHYMETER_ALLOCATIONS_HPP
+
+// Replacements of the global operator new and delete may only be defined
+// once in a program, so, like CATCH_CONFIG_MAIN, they are only defined in the
+// one translation unit that defines TACHYMETER_ALLOCATION_HOOKS before
+// including this header.
+#if defined(TACHYMETER_ALLOCATION_HOOKS) && !defined(TACHYMETER_ALLOCATION_HOOKS_DEFINED)
+#define TACHYMETER_ALLOCATION_HOOKS_DEFINED
+
+#include <cstdlib>
+#include <new>
+
+namespace tachymeter
+{
+namespace
+{
+
+const bool hooks_installed = (allocation_hooks_installed() = true);
+
+void *counted_allocate(std::size_t size) noexcept
+{
+  auto &stats = thread_allocation_stats();
+  ++stats.allocations;
+  stats.bytes += size;
+  return std::malloc(size ? size : 1);
+}
+
+// When inlined into a replacement operator delete, gcc sees free() of a
+// pointer from operator new, not knowing that it came from malloc().
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void counted_deallocate(void *p) noexcept
+{
+  if (!p) return;
+  ++thread_allocation_stats().deallocations;
+  std::free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+}
+}
+
+void *operator new(std::size_t size)
+{
+  if (auto p = tachymeter::counted_allocate(size)) return p;
+  throw std::bad_alloc{};
+}
+
+void *operator new[](std::size_t size)
+{
+  if (auto p = tachymeter::counted_allocate(size)) return p;
+  throw std::bad_alloc{};
+}
+
+void *operator new(std::size_t size, std::nothrow_t const &) noexcept
+{
+  return tachymeter::counted_allocate(size);
+}
+
+void *operator new[](std::size_t size, std::nothrow_t const &) noexcept
+{
+  return tachymeter::counted_allocate(size);
+}
+
+void operator delete(void *p) noexcept
+{
+  tachymeter::counted_deallocate(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+  tachymeter::counted_deallocate(p);
+}
+
+void operator delete(void *p, std::nothrow_t const &) noexcept
+{
+  tachymeter::counted_deallocate(p);
+}
+
+void operator delete[](void *p, std::nothrow_t const &) noexcept
+{
+  tachymeter::counted_deallocate(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+  tachymeter::counted_deallocate(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+  tachymeter::counted_deallocate(p);
+}
+
+#endif
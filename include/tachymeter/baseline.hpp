@@ -0,0 +1,177 @@
+/*
+ * Tachymeter C++ micro benchmark
+ *
+ * Copyright Björn Fahller 2015
+ *
+ *  Use, modification and distribution is subject to the
+ *  Boost Software License, Version 1.0. (See accompanying
+ *  file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ *
+ * Project home: https://github.com/rollbear/tachymeter
+ */
+
+#ifndef TACHYMETER_BASELINE_HPP
+#define TACHYMETER_BASELINE_HPP
+
+#include "reporter.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <ios>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace tachymeter
+{
+
+// Reads the results from a file written by CSV_reporter. Columns missing in
+// files from older versions are left 0. Returns false if the file could not
+// be read.
+inline bool read_CSV_results(std::string const &path, result_sequence &results)
+{
+  std::ifstream in(path);
+  if (!in) return false;
+
+  std::vector<std::string> columns;
+  std::string              line;
+  while (std::getline(in, line))
+  {
+    if (line.compare(0, 5, "#size") == 0)
+    {
+      columns.clear();
+      std::istringstream is(line.substr(1));
+      for (std::string c; std::getline(is, c, ',');) columns.push_back(c);
+      continue;
+    }
+    if (line.empty() || line[0] == '#') continue;
+
+    measurement m{ };
+    std::istringstream is(line);
+    std::size_t idx = 0;
+    for (std::string v; std::getline(is, v, ',') && idx != columns.size(); ++idx)
+    {
+      auto const value = std::strtoull(v.c_str(), nullptr, 10);
+      auto const &c = columns[idx];
+      if      (c == "size")      m.data_size      = value;
+      else if (c == "lo_q")      m.lower_quartile = value;
+      else if (c == "median")    m.median         = value;
+      else if (c == "agerage")   m.average        = value;
+      else if (c == "hi_q")      m.upper_quartile = value;
+      else if (c == "runs")      m.num_runs       = value;
+      else if (c == "median_lo") m.median_low     = value;
+      else if (c == "median_hi") m.median_high    = value;
+      else if (c.compare(0, 4, "size") == 0)
+      {
+        auto const dimension = std::strtoul(c.c_str() + 4, nullptr, 10);
+        if (dimension >= 2 && dimension <= max_parameters)
+        {
+          m.parameters[dimension - 1] = value;
+          m.num_parameters = std::max<uint64_t>(m.num_parameters, dimension);
+        }
+      }
+    }
+    if (m.num_parameters != 0) m.parameters[0] = m.data_size;
+    results.push_back(m);
+  }
+  return true;
+}
+
+// Forwards all results to another reporter, and compares the median of every
+// size point with that in a baseline directory written by CSV_reporter. A
+// difference is significant if the 95% confidence intervals of the medians
+// do not overlap (the interquartile ranges, for baselines without them), and
+// a regression if it is also slower by more than the threshold.
+class baseline_reporter : public reporter
+{
+public:
+  baseline_reporter(std::string dir_,
+                    double threshold_,
+                    reporter &next_,
+                    std::ostream &os_)
+    : dir(std::move(dir_))
+    , threshold(threshold_)
+    , next(next_)
+    , os(os_)
+  {
+  }
+  void report(result_sequence const &results, std::string const &name) override;
+  void info(std::string const &key, std::string const &value) override
+  {
+    next.info(key, value);
+  }
+  bool wants_samples() const override { return next.wants_samples(); }
+  void samples(raw_samples const &s, std::string const &name) override
+  {
+    next.samples(s, name);
+  }
+  bool regressed() const { return regression; }
+private:
+  std::string   dir;
+  double        threshold;
+  reporter      &next;
+  std::ostream  &os;
+  bool          regression = false;
+};
+
+inline
+void baseline_reporter::report(result_sequence const &results,
+                               std::string const &name)
+{
+  next.report(results, name);
+
+  result_sequence old;
+  if (!read_CSV_results(dir + "/" + name, old))
+  {
+    os << name << ": no baseline\n";
+    return;
+  }
+  auto interval = [](measurement const &m) {
+    return m.median_high != 0
+      ? std::make_pair(m.median_low, m.median_high)
+      : std::make_pair(m.lower_quartile, m.upper_quartile);
+  };
+  for (auto const &m : results)
+  {
+    auto const b = std::find_if(old.begin(), old.end(),
+                                [&](measurement const &o) {
+                                  return o.data_size == m.data_size
+                                    && o.num_parameters == m.num_parameters
+                                    && std::equal(m.parameters,
+                                                  m.parameters + m.num_parameters,
+                                                  o.parameters);
+                                });
+    if (b == old.end() || b->median == 0) continue;
+
+    auto const now_ci      = interval(m);
+    auto const base_ci     = interval(*b);
+    auto const ratio       = double(m.median) / double(b->median);
+    bool const slower      = now_ci.first > base_ci.second;
+    bool const faster      = now_ci.second < base_ci.first;
+    bool const significant = slower || faster;
+    bool const regressed   = slower && ratio > 1.0 + threshold;
+
+    os << name << ' ' << m.data_size;
+    for (std::size_t i = 1; i < m.num_parameters; ++i)
+    {
+      os << 'x' << m.parameters[i];
+    }
+    auto const precision = os.precision(1);
+    os << ": " << b->median << " -> "
+       << m.median << " (" << std::showpos << std::fixed
+       << (ratio - 1.0) * 100 << "%)"
+       << std::noshowpos << std::defaultfloat;
+    os.precision(precision);
+    if (significant) os << " significant";
+    if (regressed) os << " REGRESSION";
+    os << '\n';
+    regression = regression || regressed;
+  }
+}
+
+}
+
+#endif //TACHYMETER_BASELINE_HPP
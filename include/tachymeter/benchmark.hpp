@@ -15,34 +15,250 @@
 #define TACHYMETER_BENCHMARK_HPP
 
 #include "reporter.hpp"
+#include "clock_calibration.hpp"
+#include "histogram.hpp"
+#include "perf_counters.hpp"
+#include "allocations.hpp"
+#include "isolation.hpp"
+#include "baseline.hpp"
+#include "cache.hpp"
+#include "complexity.hpp"
+#include "laps.hpp"
 
+#include <array>
+#include <atomic>
 #include <memory>
 #include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <algorithm>
 #include <chrono>
 #include <string>
 #include <iostream>
-#include <numeric>
+#include <limits>
+#include <random>
+#include <iterator>
+#include <cmath>
+#include <cstdlib>
+#include <typeinfo>
+
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
 
 namespace tachymeter
 {
 
+// An adaptive sequence gives its sizes one at a time with next(size), and
+// gets the result of each with result(measurement), see refined_t.
+template <typename Seq, typename = void>
+struct is_adaptive_seq : std::false_type { };
+
+template <typename Seq>
+struct is_adaptive_seq<Seq,
+                       decltype(void(std::declval<Seq&>().result(
+                         std::declval<measurement const&>())))>
+  : std::true_type { };
+
+template <typename Seq, typename = void>
+struct seq_size_type
+{
+  using type = std::size_t;
+};
+
+template <typename Seq>
+struct seq_size_type<Seq, decltype(void(std::begin(std::declval<Seq&>())))>
+{
+  using type = std::decay_t<decltype(*std::begin(std::declval<Seq&>()))>;
+};
+
+// A setup with a member function reset(size), that restores it to the state
+// it was constructed in, is constructed once for each size and reset before
+// every further call, instead of being constructed for every call.
+template <typename Setup, typename T, typename = void>
+struct has_reset : std::false_type { };
+
+template <typename Setup, typename T>
+struct has_reset<Setup,
+                 T,
+                 decltype(void(std::declval<Setup&>().reset(
+                   std::declval<T const&>())))>
+  : std::true_type { };
+
+// A setup with the static member copy_prototype set to true is constructed
+// once for each size, and copied for every call.
+template <typename Setup, typename = void>
+struct copies_prototype : std::false_type { };
+
+template <typename Setup>
+struct copies_prototype<Setup, std::enable_if_t<Setup::copy_prototype>>
+  : std::true_type { };
+
+// A setup whose function call operator also takes a laps& times the phases
+// of the calls.
+template <typename Setup, typename T, typename = void>
+struct times_laps : std::false_type { };
+
+template <typename Setup, typename T>
+struct times_laps<Setup,
+                  T,
+                  decltype(void(std::declval<Setup&>()(
+                    std::declval<T const&>(), std::declval<laps&>())))>
+  : std::true_type { };
+
+template <typename Setup, typename T>
+void call_setup(Setup &setup, T const &size, laps &l, std::true_type)
+{
+  setup(size, l);
+}
+
+template <typename Setup, typename T>
+void call_setup(Setup &setup, T const &size, laps &, std::false_type)
+{
+  setup(size);
+}
+
+// Compared setups that can be constructed as Setup(size, seed) get the same
+// seed, so that they can generate the same input.
+using seed_type = std::uint32_t;
+
+template <typename Setup, typename T>
+std::unique_ptr<Setup> make_setup(T const &size, seed_type seed, std::true_type)
+{
+  return std::unique_ptr<Setup>(new Setup(size, seed));
+}
+
+template <typename Setup, typename T>
+std::unique_ptr<Setup> make_setup(T const &size, seed_type, std::false_type)
+{
+  return std::unique_ptr<Setup>(new Setup(size));
+}
+
+// The element types of typed measurements.
+template <typename ... Ts>
+struct type_list { };
+
+// The name of a type in the names of typed measurements. Demangled where
+// the compiler supports it.
+template <typename T>
+std::string type_name()
+{
+  char const *mangled = typeid(T).name();
+#if defined(__GNUG__)
+  int  status = 0;
+  std::unique_ptr<char, void(*)(void*)> demangled(
+    abi::__cxa_demangle(mangled, nullptr, nullptr, &status),
+    std::free);
+  if (status == 0 && demangled) return demangled.get();
+#endif
+  return mangled;
+}
+
 template <typename C>
 class benchmark
 {
 public:
+  struct options
+  {
+    typename C::duration min_time;
+    // When non-zero, calls are timed in batches large enough to fill this
+    // window, and the per call average of each batch is the sample.
+    typename C::duration batch_window{};
+    // When non-zero, sampling continues past min_time until the 95%
+    // confidence interval of the median is narrower than this fraction of
+    // the median, or until max_time or max_runs, if non-zero, is reached.
+    // A zero max_time is then 100 times min_time, and a zero median never
+    // meets the target.
+    double               precision = 0.0;
+    typename C::duration max_time{};
+    uint64_t             max_runs = 0;
+    // Collect hardware and software event counters around the timed calls.
+    bool                 counters = false;
+    // Count global operator new/delete calls made by the timed calls. Needs
+    // the hooks from allocations.hpp.
+    bool                 allocations = false;
+    // Fit the medians of all sizes to complexities, and fail run() if the
+    // best fit grows faster than this.
+    complexity           expected_complexity = complexity::none;
+    // When non-zero, each size is first run until the median of a window of
+    // samples is within 2% of that of the window before, or for at most
+    // this long. These samples are not part of the measurement.
+    typename C::duration max_warmup{};
+    // Evict all caches after constructing the setups and before timing the
+    // calls, so that the calls start with a cold cache. Only one call can
+    // follow an eviction, so the batch_window is ignored.
+    bool                 cold_cache = false;
+  };
   benchmark(reporter &r_) : r(r_) { }
-  void run(int argc, char *argv[], std::ostream &ostr = std::cout);
+  // Returns non-zero if a comparison with a baseline (-b) found a regression,
+  // a measurement grew faster than its expected complexity, or if the
+  // arguments are malformed.
+  int run(int argc, char *argv[], std::ostream &ostr = std::cout);
+  // Controls for the measuring thread, applied by run(). The outcome is
+  // passed to the reporter through reporter::info().
+  void cpus(std::vector<int> set) { cpu_set = std::move(set); }
+  void fifo_scheduling(bool on = true) { fifo = on; }
+  void lock_memory(bool on = true) { lock = on; }
+  // Splits the measurement of every size into this many rounds, run in a
+  // random order across all jobs, unless the jobs run in child processes.
+  void interleave(std::size_t rounds_) { rounds = rounds_; }
+  template <typename Setup, typename Seq>
+  void measure(Seq &&seq, std::string name, typename C::duration min_time);
   template <typename Setup, typename Seq>
+  void measure(Seq &&seq, std::string name, options const &opts);
+  // Measures Setup<T> for every type T in the type_list Types, named
+  // name<T>.
+  template <template <typename...> class Setup, typename Types, typename Seq>
   void measure(Seq &&seq, std::string name, typename C::duration min_time);
+  template <template <typename...> class Setup, typename Types, typename Seq>
+  void measure(Seq &&seq, std::string name, options const &opts);
+  template <typename Setup, typename Seq, typename Threads>
+  void measure_threaded(Seq                  &&seq,
+                        Threads              &&threads,
+                        std::string          name,
+                        typename C::duration min_time);
+  // Measures SetupA and SetupB in pairs of calls, alternating which is called
+  // first, on setups constructed from the same seed for each pair. The results are
+  // reported as name_a and name_b, with the speedup of B over A at each
+  // size. Of the options, only min_time, precision, max_time, max_runs and
+  // expected_complexity apply, where precision is that of the speedup,
+  // max_runs counts the calls of each setup, and both setups are expected to
+  // have the complexity.
+  template <typename SetupA, typename SetupB, typename Seq>
+  void compare(Seq                  &&seq,
+               std::string          name_a,
+               std::string          name_b,
+               typename C::duration min_time);
+  template <typename SetupA, typename SetupB, typename Seq>
+  void compare(Seq           &&seq,
+               std::string   name_a,
+               std::string   name_b,
+               options const &opts);
 private:
   class job
   {
   public:
     job(std::string&& n) : job_name(std::move(n)) {}
     virtual ~job() = default;
-    virtual void run(reporter &r) = 0;
-    bool matches(int argc, char *argv[]) const;
+    virtual void run(reporter &r, clock_calibration<C> const &clock) = 0;
+    // Interleaved execution splits the measurement of each size into rounds,
+    // run in any order, before the results are reported. prepare_rounds()
+    // returns the number of sizes, or 0 if the job cannot be interleaved.
+    virtual std::size_t prepare_rounds(reporter &) { return 0; }
+    virtual void run_round(std::size_t                /* index */,
+                           std::size_t                /* round */,
+                           std::size_t                /* rounds */,
+                           clock_calibration<C> const & /* clock */) { }
+    virtual void report_rounds(reporter &, clock_calibration<C> const &) { }
+    virtual complexity expected_complexity() const { return complexity::none; }
+    // The names the results are reported under.
+    virtual std::vector<std::string> reported_names() const
+    {
+      return { job_name };
+    }
+    bool matches(char *const *first, char *const *last) const;
     std::string const& name() const { return job_name;}
   private:
     std::string job_name;
@@ -54,44 +270,455 @@ private:
     template <typename S,
               typename = std::enable_if_t<std::is_same<Seq,
                                                        std::decay_t<S>>::value>>
-    job_t(std::string a_name, S &&a_seq, typename C::duration min_time_)
+    job_t(std::string a_name, S &&a_seq, options const &opts_)
         : job(std::move(a_name))
         , seq(std::forward<S>(a_seq))
+        , opts(opts_) { }
+    virtual void run(reporter &r, clock_calibration<C> const &clock) override;
+    std::size_t prepare_rounds(reporter &r) override;
+    void run_round(std::size_t                index,
+                   std::size_t                round,
+                   std::size_t                rounds,
+                   clock_calibration<C> const &clock) override;
+    void report_rounds(reporter &r, clock_calibration<C> const &clock) override;
+    complexity expected_complexity() const override
+    {
+      return opts.expected_complexity;
+    }
+  private:
+    using size_type = typename seq_size_type<Seq>::type;
+    // The measurement of one size, so far.
+    struct point
+    {
+      point(size_type size_) : size(size_) { }
+      size_type              size;
+      std::size_t            batch = 0;
+      histogram              samples;
+      histogram              warmup_samples;
+      bool                   settled = true;
+      std::vector<histogram> counter_samples;
+      allocation_stats       allocated{ };
+      typename C::duration   total_duration{ };
+      // Time spent evicting caches, which counts towards min_time and
+      // max_warmup, as the eviction often takes far longer than the calls.
+      typename C::duration   evicting{ };
+      // Per call times of the phases, indexed as phases.
+      std::vector<histogram> phase_samples;
+      uint64_t               next_check = 0;
+      // Only filled in when the reporter wants raw samples.
+      raw_samples            raw;
+    };
+    void prepare(reporter &r);
+    std::size_t calibrate_batch(point &p);
+    typename C::duration time_batch(point       &p,
+                                    std::size_t batch,
+                                    bool        instrumented);
+    bool enough(point &p) const;
+    void record_counters(point &p);
+    void record_laps(point &p, clock_calibration<C> const &clock);
+    // The overhead of the clock reads of the last timed batch, one for the
+    // batch and one per lap.
+    typename C::duration read_overhead(clock_calibration<C> const &clock) const
+    {
+      auto const laps_read = timed_laps ? phase_laps.reads() : 0U;
+      return clock.overhead * static_cast<int64_t>(1 + laps_read);
+    }
+    void report_phases(reporter &r);
+    static int64_t now_ticks()
+    {
+      return static_cast<int64_t>((C::now() - typename C::time_point{ }).count());
+    }
+    bool warm_up(point &p, clock_calibration<C> const &clock);
+    void sample(point                      &p,
+                clock_calibration<C> const &clock,
+                typename C::duration       until,
+                bool                       last);
+    measurement finish(point &p, reporter &r, clock_calibration<C> const &clock);
+    void make_setups(point &p, std::size_t batch, std::true_type, std::false_type);
+    void make_setups(point &p, std::size_t batch, std::false_type, std::true_type);
+    void make_setups(point &p, std::size_t batch, std::false_type, std::false_type);
+    static constexpr bool reuses_setups = has_reset<Setup, size_type>::value;
+    static constexpr bool copies_setups = !reuses_setups
+                                          && copies_prototype<Setup>::value;
+    static constexpr bool timed_laps = times_laps<Setup, size_type>::value;
+    Seq                            seq;
+    options const                  opts;
+    // The setups of the batch timed next. Reset or copied setups are only
+    // constructed once per sample() call.
+    std::deque<Setup>              setups;
+    std::unique_ptr<Setup>         prototype;
+    laps                           phase_laps;
+    // The names of the phases timed with laps, in the order first seen, and
+    // their results so far.
+    std::vector<std::string>       phases;
+    std::vector<result_sequence>   phase_results;
+    std::unique_ptr<perf_counters> pmu;
+    std::unique_ptr<cache_evictor> evictor;
+    bool                           keep_raw = false;
+    // The sizes being measured in rounds.
+    std::vector<point>             points;
+  };
+  template <typename Setup, typename Seq, typename Threads>
+  class threaded_job_t : public job
+  {
+  public:
+    template <typename S, typename T>
+    threaded_job_t(std::string          a_name,
+                   S                    &&a_seq,
+                   T                    &&a_threads,
+                   typename C::duration min_time_)
+        : job(std::move(a_name))
+        , seq(std::forward<S>(a_seq))
+        , threads(std::forward<T>(a_threads))
         , min_time(min_time_) { }
-    virtual void run(reporter &r) override;
+    virtual void run(reporter &r, clock_calibration<C> const &clock) override;
   private:
     Seq                        seq;
+    Threads                    threads;
     typename C::duration const min_time;
   };
-  reporter                          &r;
-  std::vector<std::unique_ptr<job>> jobs;
+  template <typename SetupA, typename SetupB, typename Seq>
+  class compare_job_t : public job
+  {
+  public:
+    template <typename S>
+    compare_job_t(std::string   a_name,
+                  std::string   b_name,
+                  S             &&a_seq,
+                  options const &opts_)
+        : job(a_name + " vs " + b_name)
+        , name_a(std::move(a_name))
+        , name_b(std::move(b_name))
+        , seq(std::forward<S>(a_seq))
+        , opts(opts_) { }
+    virtual void run(reporter &r, clock_calibration<C> const &clock) override;
+    complexity expected_complexity() const override
+    {
+      return opts.expected_complexity;
+    }
+    std::vector<std::string> reported_names() const override
+    {
+      return { name_a, name_b };
+    }
+  private:
+    using size_type = typename seq_size_type<Seq>::type;
+    bool enough(std::vector<double> const &speedups,
+                typename C::duration      total,
+                uint64_t                  &next_check) const;
+    std::string   name_a;
+    std::string   name_b;
+    Seq           seq;
+    options const opts;
+  };
+  template <template <typename...> class Setup, typename Seq, typename ... Ts>
+  void measure_types(Seq const         &seq,
+                     std::string const &name,
+                     options const     &opts,
+                     type_list<Ts...>);
+  clock_calibration<C> const &calibration();
+  void apply_environment();
+  void run_isolated(std::vector<job*> const &selected,
+                    std::size_t             processes,
+                    reporter                &out,
+                    std::ostream            &ostr);
+  void run_interleaved(std::vector<job*> const &selected, reporter &out);
+  reporter                                   &r;
+  std::vector<std::unique_ptr<job>>          jobs;
+  std::unique_ptr<clock_calibration<C> const> clock;
+  std::vector<int>                           cpu_set;
+  bool                                       fifo = false;
+  bool                                       lock = false;
+  std::size_t                                rounds = 0;
 };
 
 
 template <typename C>
-void benchmark<C>::run(int argc, char *argv[], std::ostream &ostr)
+int benchmark<C>::run(int argc, char *argv[], std::ostream &ostr)
 {
-  if (argc > 1 && argv[1][0] == '-')
+  std::size_t processes = 0;
+  char const  *baseline = nullptr;
+  double      threshold = 5.0;
+  bool        fit_all = false;
+  int         first_name = 1;
+  for (; first_name < argc && argv[first_name][0] == '-'; ++first_name)
   {
-    switch (argv[1][1])
+    char const *flag = argv[first_name];
+    // Flag values are accepted both as -j4 and as -j 4
+    auto value = [&]() -> char const* {
+      if (flag[2]) return flag + 2;
+      return first_name + 1 < argc ? argv[++first_name] : nullptr;
+    };
+    bool valid = true;
+    switch (flag[1])
+    {
+      case 'l': for (auto& j : jobs) { ostr << j->name() << '\n';} return 0;
+      case 'j':
+      {
+        auto const v = value();
+        processes = v ? std::strtoul(v, nullptr, 10) : 0;
+        valid = processes != 0;
+        break;
+      }
+      case 'c':
+        cpu_set = parse_cpu_list(value());
+        valid = !cpu_set.empty();
+        break;
+      case 'f': fifo = true; break;
+      case 'm': lock = true; break;
+      case 'a': fit_all = true; break;
+      case 'i':
+      {
+        auto const v = value();
+        rounds = v ? std::strtoul(v, nullptr, 10) : 0;
+        valid = rounds != 0;
+        break;
+      }
+      case 'b':
+        baseline = value();
+        valid = baseline != nullptr;
+        break;
+      case 't':
+      {
+        auto const v = value();
+        char *end = nullptr;
+        threshold = v ? std::strtod(v, &end) : -1.0;
+        valid = v && *end == '\0' && threshold >= 0.0;
+        break;
+      }
+      default: valid = false;
+    }
+    if (!valid)
     {
-      case 'l': for (auto& j : jobs) { ostr << j->name() << '\n';} return;
-      default: ostr << "Usage: " << argv[0] << " {-l | <names>}\n"; return;
+      ostr << "Usage: " << argv[0]
+           << " [-j <processes>] [-c <cpus>] [-f] [-m]"
+              " [-i <rounds>] [-b <baseline dir> [-t <percent>]] [-a]"
+              " {-l | <names>}\n";
+      return 1;
     }
   }
+  std::vector<job*> selected;
   for (auto &j : jobs)
   {
-    if (j->matches(argc, argv))
+    if (j->matches(argv + first_name, argv + argc))
+    {
+      selected.push_back(j.get());
+    }
+  }
+  std::unique_ptr<baseline_reporter> compared;
+  reporter                           *out = &r;
+  if (baseline)
+  {
+    compared.reset(new baseline_reporter(baseline, threshold / 100, r, ostr));
+    out = compared.get();
+  }
+  std::unique_ptr<complexity_reporter> fitted;
+  for (auto j : selected)
+  {
+    if (!fit_all && j->expected_complexity() == complexity::none) continue;
+    if (!fitted) fitted.reset(new complexity_reporter(*out, ostr));
+    for (auto const &name : j->reported_names())
     {
-      j->run(r);
+      fitted->expect(name, j->expected_complexity());
     }
   }
+  if (fitted) out = fitted.get();
+  apply_environment();
+  if (processes != 0)
+  {
+    run_isolated(selected, processes, *out, ostr);
+  }
+  else if (rounds != 0)
+  {
+    run_interleaved(selected, *out);
+  }
+  else
+  {
+    for (auto j : selected)
+    {
+      j->run(*out, calibration());
+    }
+  }
+  return (compared && compared->regressed()) || (fitted && fitted->failed())
+    ? 1 : 0;
 }
 
 template <typename C>
-bool benchmark<C>::job::matches(int argc, char *argv[]) const
+void benchmark<C>::apply_environment()
 {
-  return argc == 1 || std::find(argv + 1, argv + argc, job_name) != argv + argc;
+  if (!cpu_set.empty())
+  {
+    bool const ok = set_cpu_affinity(cpu_set);
+    r.info("cpus", format_cpu_list(cpu_set) + (ok ? "" : " (refused)"));
+  }
+  if (fifo)
+  {
+    r.info("scheduling", set_fifo_scheduling() ? "SCHED_FIFO"
+                                               : "SCHED_FIFO (refused)");
+  }
+  if (lock)
+  {
+    r.info("memory", tachymeter::lock_memory() ? "locked" : "lock refused");
+  }
+}
+
+template <typename C>
+void benchmark<C>::run_isolated(std::vector<job*> const &selected,
+                                std::size_t             processes,
+                                reporter                &out,
+                                std::ostream            &ostr)
+{
+  auto const &run_clock = calibration();
+#if defined(TACHYMETER_HAS_FORK)
+  struct child
+  {
+    pid_t       pid;
+    int         fd;
+    std::size_t job;
+    int         cpu;
+  };
+  auto                     free_cpus = available_cpus();
+  std::vector<child>       running;
+  std::vector<std::string> outputs(selected.size());
+  std::vector<int>         status(selected.size(), -1);
+  std::size_t              next_job = 0;
+  std::size_t              next_report = 0;
+
+  processes = std::min(processes, free_cpus.size());
+  free_cpus.resize(processes);
+  while (next_report != selected.size())
+  {
+    while (running.size() < processes && next_job != selected.size())
+    {
+      auto const cpu = free_cpus.back();
+      int        fds[2];
+      pid_t      pid = -1;
+      if (pipe(fds) == 0 && (pid = fork()) == -1)
+      {
+        close(fds[0]);
+        close(fds[1]);
+      }
+      if (pid == 0)
+      {
+        close(fds[0]);
+        pin_to_cpu(cpu);
+        // memory locks are not inherited by child processes
+        if (lock) tachymeter::lock_memory();
+        std::string     buffer;
+        stream_reporter child_out(buffer, out.wants_samples());
+        selected[next_job]->run(child_out, run_clock);
+        for (std::size_t pos = 0; pos != buffer.size();)
+        {
+          auto const n = write(fds[1], buffer.data() + pos, buffer.size() - pos);
+          if (n <= 0) _exit(1);
+          pos += std::size_t(n);
+        }
+        _exit(0);
+      }
+      if (pid == -1)
+      {
+        // no process to isolate the job in, run it here instead
+        stream_reporter here(outputs[next_job], out.wants_samples());
+        selected[next_job]->run(here, run_clock);
+        status[next_job++] = 0;
+        continue;
+      }
+      close(fds[1]);
+      free_cpus.pop_back();
+      running.push_back({ pid, fds[0], next_job++, cpu });
+    }
+
+    std::vector<pollfd> polled;
+    for (auto &c : running) polled.push_back({ c.fd, POLLIN, 0 });
+    if (!polled.empty()) poll(polled.data(), polled.size(), -1);
+    for (std::size_t i = polled.size(); i-- != 0;)
+    {
+      if (polled[i].revents == 0) continue;
+      auto &c = running[i];
+      char buffer[4096];
+      auto const n = read(c.fd, buffer, sizeof(buffer));
+      if (n > 0)
+      {
+        outputs[c.job].append(buffer, std::size_t(n));
+        continue;
+      }
+      close(c.fd);
+      int wstatus = 0;
+      waitpid(c.pid, &wstatus, 0);
+      status[c.job] = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 1;
+      free_cpus.push_back(c.cpu);
+      running.erase(running.begin() + std::ptrdiff_t(i));
+    }
+
+    // Results are passed on in the order the jobs were added.
+    for (; next_report != selected.size() && status[next_report] != -1;
+         ++next_report)
+    {
+      if (!replay(outputs[next_report], out) || status[next_report] != 0)
+      {
+        ostr << selected[next_report]->name() << ": child process failed\n";
+      }
+    }
+  }
+#else
+  static_cast<void>(processes);
+  static_cast<void>(ostr);
+  for (auto j : selected)
+  {
+    j->run(out, run_clock);
+  }
+#endif
+}
+
+template <typename C>
+void benchmark<C>::run_interleaved(std::vector<job*> const &selected,
+                                   reporter                &out)
+{
+  auto const &run_clock = calibration();
+  auto const seed       = std::random_device{}();
+  r.info("interleaving", std::to_string(rounds) + " rounds, seed "
+                         + std::to_string(seed));
+
+  std::vector<std::pair<job*, std::size_t>> points;
+  std::vector<bool>                         interleaved;
+  for (auto j : selected)
+  {
+    auto const num_points = j->prepare_rounds(out);
+    interleaved.push_back(num_points != 0);
+    for (std::size_t i = 0; i != num_points; ++i) points.emplace_back(j, i);
+  }
+  std::mt19937 generator(seed);
+  for (std::size_t round = 0; round != rounds; ++round)
+  {
+    std::shuffle(points.begin(), points.end(), generator);
+    for (auto &p : points)
+    {
+      p.first->run_round(p.second, round, rounds, run_clock);
+    }
+  }
+  // Jobs that cannot be interleaved run as usual, in their turn to report.
+  for (std::size_t i = 0; i != selected.size(); ++i)
+  {
+    if (interleaved[i]) selected[i]->report_rounds(out, run_clock);
+    else selected[i]->run(out, run_clock);
+  }
+}
+
+template <typename C>
+clock_calibration<C> const &benchmark<C>::calibration()
+{
+  if (!clock)
+  {
+    clock.reset(new clock_calibration<C>(calibrate_clock<C>()));
+    r.info("clock overhead", std::to_string(clock->overhead.count()));
+    r.info("clock resolution", std::to_string(clock->resolution.count()));
+  }
+  return *clock;
+}
+
+template <typename C>
+bool benchmark<C>::job::matches(char *const *first, char *const *last) const
+{
+  return first == last || std::find(first, last, job_name) != last;
 }
 
 template <typename C>
@@ -99,63 +726,855 @@ template <typename Setup, typename Seq>
 void benchmark<C>::measure(Seq &&seq,
                            std::string name,
                            typename C::duration min_time)
+{
+  measure<Setup>(std::forward<Seq>(seq), std::move(name), options{ min_time });
+}
+
+template <typename C>
+template <typename Setup, typename Seq>
+void benchmark<C>::measure(Seq &&seq,
+                           std::string name,
+                           options const &opts)
 {
   using job_type = job_t<Setup, std::decay_t<Seq>>;
   jobs.emplace_back(new job_type(std::move(name),
                                  std::forward<Seq>(seq),
+                                 opts));
+}
+
+template <typename C>
+template <template <typename...> class Setup, typename Types, typename Seq>
+void benchmark<C>::measure(Seq &&seq,
+                           std::string name,
+                           typename C::duration min_time)
+{
+  measure<Setup, Types>(std::forward<Seq>(seq), std::move(name), options{ min_time });
+}
+
+template <typename C>
+template <template <typename...> class Setup, typename Types, typename Seq>
+void benchmark<C>::measure(Seq &&seq,
+                           std::string name,
+                           options const &opts)
+{
+  measure_types<Setup>(seq, name, opts, Types{ });
+}
+
+template <typename C>
+template <template <typename...> class Setup, typename Seq, typename ... Ts>
+void benchmark<C>::measure_types(Seq const         &seq,
+                                 std::string const &name,
+                                 options const     &opts,
+                                 type_list<Ts...>)
+{
+  int const expand[] = {
+    0, (measure<Setup<Ts>>(std::decay_t<Seq>(seq),
+                           name + '<' + type_name<Ts>() + '>',
+                           opts), 0)...
+  };
+  static_cast<void>(expand);
+}
+
+template <typename C>
+template <typename Setup, typename Seq, typename Threads>
+void benchmark<C>::measure_threaded(Seq                  &&seq,
+                                    Threads              &&threads,
+                                    std::string          name,
+                                    typename C::duration min_time)
+{
+  using job_type = threaded_job_t<Setup,
+                                  std::decay_t<Seq>,
+                                  std::decay_t<Threads>>;
+  jobs.emplace_back(new job_type(std::move(name),
+                                 std::forward<Seq>(seq),
+                                 std::forward<Threads>(threads),
                                  min_time));
 }
 
+template <typename C>
+template <typename SetupA, typename SetupB, typename Seq>
+void benchmark<C>::compare(Seq                  &&seq,
+                           std::string          name_a,
+                           std::string          name_b,
+                           typename C::duration min_time)
+{
+  compare<SetupA, SetupB>(std::forward<Seq>(seq),
+                          std::move(name_a),
+                          std::move(name_b),
+                          options{ min_time });
+}
+
+template <typename C>
+template <typename SetupA, typename SetupB, typename Seq>
+void benchmark<C>::compare(Seq           &&seq,
+                           std::string   name_a,
+                           std::string   name_b,
+                           options const &opts)
+{
+  using job_type = compare_job_t<SetupA, SetupB, std::decay_t<Seq>>;
+  jobs.emplace_back(new job_type(std::move(name_a),
+                                 std::move(name_b),
+                                 std::forward<Seq>(seq),
+                                 opts));
+}
+
 namespace
 {
 
 template <typename T>
 bool is_even(T t) { return (t & 1) == 0; }
 
+// Adaptive sequences do not give their sizes in order, so their results are
+// sorted by size. Other sequences are reported in the order they give.
+template <typename Seq>
+void order_results(result_sequence &results)
+{
+  if (!is_adaptive_seq<Seq>::value) return;
+  std::stable_sort(results.begin(), results.end(),
+                   [](measurement const &lh, measurement const &rh) {
+                     return lh.data_size < rh.data_size;
+                   });
+}
+
+// The max_time of the options, or, when a precision target is set without
+// one, 100 times min_time, so that sampling ends even if the target is never
+// met.
+template <typename Options>
+auto max_time_of(Options const &opts)
+{
+  using duration = decltype(opts.max_time);
+  if (opts.max_time != duration{ } || opts.precision <= 0.0)
+  {
+    return opts.max_time;
+  }
+  return 100 * opts.min_time;
 }
+
+// Medians closer than this many clock ticks to the resolution are flagged.
+constexpr uint64_t resolution_margin = 4;
+
+// A setup declares how much one call processes with the optional static
+// member functions items_processed(size) and bytes_processed(size).
+template <typename Setup, typename T>
+auto items_processed(T const &size, int)
+  -> decltype(double(Setup::items_processed(size)))
+{
+  return double(Setup::items_processed(size));
+}
+
+template <typename Setup, typename T>
+double items_processed(T const &, long)
+{
+  return std::numeric_limits<double>::quiet_NaN();
+}
+
+template <typename Setup, typename T>
+auto bytes_processed(T const &size, int)
+  -> decltype(double(Setup::bytes_processed(size)))
+{
+  return double(Setup::bytes_processed(size));
+}
+
+template <typename Setup, typename T>
+double bytes_processed(T const &, long)
+{
+  return std::numeric_limits<double>::quiet_NaN();
+}
+
+// Calls f with each size of seq, and passes the results back to adaptive
+// sequences.
+template <typename Seq, typename F>
+void each_size(Seq &seq, F f, std::true_type /* adaptive */)
+{
+  std::size_t size;
+  while (seq.next(size)) seq.result(f(size));
+}
+
+template <typename Seq, typename F>
+void each_size(Seq &seq, F f, std::false_type /* adaptive */)
+{
+  for (auto size : seq) f(size);
+}
+
+template <typename Setup, typename T>
+void set_throughput(measurement &m, T const &size, double calls_per_second)
+{
+  auto const items   = items_processed<Setup>(size, 0);
+  auto const bytes   = bytes_processed<Setup>(size, 0);
+  m.has_throughput   = !std::isnan(items) || !std::isnan(bytes);
+  m.items_per_second = items * calls_per_second;
+  m.bytes_per_second = bytes * calls_per_second;
+}
+
+// The data size is the first dimension of multi-dimensional sequences.
+template <typename T>
+uint64_t data_size_of(T const &size)
+{
+  return static_cast<uint64_t>(size);
+}
+
+template <std::size_t N>
+uint64_t data_size_of(std::array<std::size_t, N> const &parameters)
+{
+  return parameters[0];
+}
+
+template <typename T>
+void set_parameters(measurement &, T const &) { }
+
+template <std::size_t N>
+void set_parameters(measurement &m, std::array<std::size_t, N> const &parameters)
+{
+  static_assert(N <= max_parameters, "too many dimensions");
+  m.num_parameters = N;
+  std::copy(parameters.begin(), parameters.end(), m.parameters);
+}
+
+template <typename T>
+measurement measurement_of(T const &size, histogram const &samples)
+{
+  measurement m = summary_of(samples);
+  m.data_size   = data_size_of(size);
+  set_parameters(m, size);
+  return m;
+}
+
+}
+template <typename C>
+template <typename Setup, typename Seq>
+typename C::duration
+benchmark<C>::job_t<Setup, Seq>::time_batch(point       &p,
+                                            std::size_t batch,
+                                            bool        instrumented)
+{
+  make_setups(p,
+              batch,
+              std::integral_constant<bool, reuses_setups>{ },
+              std::integral_constant<bool, copies_setups>{ });
+  if (evictor)
+  {
+    auto const start = C::now();
+    evictor->evict();
+    p.evicting += C::now() - start;
+  }
+
+  bool const count_allocations = instrumented && opts.allocations;
+  allocation_stats allocs_before{ };
+
+  // The allocation counts and the counters are read outside of the timed
+  // calls, so that reading them is not part of the time.
+  if (count_allocations) allocs_before = thread_allocation_stats();
+  if (instrumented && pmu) pmu->start();
+  if (timed_laps) phase_laps.reset(&now_ticks);
+  auto const before = C::now();
+  if (timed_laps)
+  {
+    phase_laps.start(static_cast<int64_t>(
+      (before - typename C::time_point{ }).count()));
+  }
+  auto const end = setups.begin() + static_cast<std::ptrdiff_t>(batch);
+  for (auto i = setups.begin(); i != end; ++i)
+  {
+    call_setup(*i,
+               p.size,
+               phase_laps,
+               std::integral_constant<bool, timed_laps>{ });
+  }
+  auto const after = C::now();
+  if (instrumented && pmu) pmu->stop();
+  if (count_allocations) p.allocated += thread_allocation_stats() - allocs_before;
+
+  if (!reuses_setups) setups.clear();
+  return after - before;
+}
+
+template <typename C>
+template <typename Setup, typename Seq>
+void benchmark<C>::job_t<Setup, Seq>::make_setups(point       &p,
+                                                  std::size_t batch,
+                                                  std::true_type  /* reset */,
+                                                  std::false_type /* copy */)
+{
+  auto const used = std::min(setups.size(), batch);
+  for (std::size_t i = 0; i != used; ++i) setups[i].reset(p.size);
+  while (setups.size() < batch) setups.emplace_back(p.size);
+}
+
+template <typename C>
+template <typename Setup, typename Seq>
+void benchmark<C>::job_t<Setup, Seq>::make_setups(point       &p,
+                                                  std::size_t batch,
+                                                  std::false_type /* reset */,
+                                                  std::true_type  /* copy */)
+{
+  if (!prototype) prototype.reset(new Setup(p.size));
+  while (setups.size() < batch) setups.emplace_back(*prototype);
+}
+
+template <typename C>
+template <typename Setup, typename Seq>
+void benchmark<C>::job_t<Setup, Seq>::make_setups(point       &p,
+                                                  std::size_t batch,
+                                                  std::false_type /* reset */,
+                                                  std::false_type /* copy */)
+{
+  while (setups.size() < batch) setups.emplace_back(p.size);
+}
+
+template <typename C>
+template <typename Setup, typename Seq>
+std::size_t benchmark<C>::job_t<Setup, Seq>::calibrate_batch(point &p)
+{
+  constexpr std::size_t max_batch = std::size_t{1} << 20;
+
+  // A phase starts at the call, which a batch only reads the clock before
+  // the first of, and each lap reads the clock anyway, so setups timing laps
+  // are not batched.
+  if (opts.batch_window == typename C::duration{}
+      || opts.cold_cache
+      || timed_laps)
+  {
+    return 1;
+  }
+
+  std::size_t batch = 1;
+  while (batch < max_batch
+         && time_batch(p, batch, false) < opts.batch_window)
+  {
+    batch *= 2;
+  }
+  return batch;
+}
+
+template <typename C>
+template <typename Setup, typename Seq>
+void benchmark<C>::job_t<Setup, Seq>::record_counters(point &p)
+{
+  auto const values = pmu->read();
+  for (std::size_t i = 0; i != num_counters; ++i)
+  {
+    if (values[i] != counter_unavailable)
+    {
+      p.counter_samples[i].record(values[i] / p.batch);
+      if (keep_raw) p.raw.counters[i].push_back(values[i] / p.batch);
+    }
+  }
+}
+
+// Each lap reads the clock once, so the clock overhead is subtracted per lap.
+template <typename C>
+template <typename Setup, typename Seq>
+void benchmark<C>::job_t<Setup, Seq>::record_laps(point                      &p,
+                                                  clock_calibration<C> const &clock)
+{
+  auto const overhead = static_cast<uint64_t>(clock.overhead.count());
+  for (std::size_t i = 0; i != phase_laps.phases(); ++i)
+  {
+    auto const name  = phase_laps.name(i);
+    auto const phase = static_cast<std::size_t>(
+      std::find(phases.begin(), phases.end(), name) - phases.begin());
+    if (phase == phases.size()) phases.emplace_back(name);
+    if (p.phase_samples.size() < phases.size())
+    {
+      p.phase_samples.resize(phases.size());
+    }
+    auto const ticks = phase_laps.ticks(i);
+    auto const ends  = phase_laps.count(i);
+    auto const net   = ticks - std::min(ticks, overhead * ends);
+    p.phase_samples[phase].record(net / p.batch);
+  }
+}
+
+// The phases are reported after the whole calls, as name.phase.
+template <typename C>
+template <typename Setup, typename Seq>
+void benchmark<C>::job_t<Setup, Seq>::report_phases(reporter &r)
+{
+  for (std::size_t i = 0; i != phase_results.size(); ++i)
+  {
+    auto &results = phase_results[i];
+    order_results<Seq>(results);
+    r.report(results, job::name() + '.' + phases[i]);
+  }
+  phase_results.clear();
+}
+
+template <typename C>
+template <typename Setup, typename Seq>
+bool benchmark<C>::job_t<Setup, Seq>::warm_up(point                      &p,
+                                              clock_calibration<C> const &clock)
+{
+  constexpr std::size_t window = 16;
+
+  std::vector<uint64_t> recent;
+  uint64_t              previous_median = 0;
+  typename C::duration  total_duration{ };
+  auto const            evicted_before = p.evicting;
+  for (std::size_t windows = 0;; ++windows)
+  {
+    recent.clear();
+    while (recent.size() != window)
+    {
+      auto const run_duration = time_batch(p, p.batch, false);
+      auto const net_duration = std::max(run_duration - read_overhead(clock),
+                                         typename C::duration{ });
+      total_duration += run_duration;
+      recent.push_back(static_cast<uint64_t>((net_duration / p.batch).count()));
+      p.warmup_samples.record(recent.back());
+    }
+    auto const mid = recent.begin() + window / 2;
+    std::nth_element(recent.begin(), mid, recent.end());
+    auto const median = *mid;
+    auto const change = median > previous_median ? median - previous_median
+                                                 : previous_median - median;
+    bool const settled = windows != 0 && change * 50 <= previous_median;
+    if (settled
+        || total_duration + p.evicting - evicted_before >= opts.max_warmup)
+    {
+      // The warmup is not part of the measurement.
+      p.evicting = evicted_before;
+      return settled;
+    }
+    previous_median = median;
+  }
+}
+
+template <typename C>
+template <typename Setup, typename Seq>
+bool benchmark<C>::job_t<Setup, Seq>::enough(point &p) const
+{
+  auto const  total   = p.total_duration + p.evicting;
+  auto const &samples = p.samples;
+  if (total < opts.min_time) return false;
+  if (opts.precision <= 0.0) return true;
+  if (opts.max_runs != 0 && samples.count() * p.batch >= opts.max_runs)
+  {
+    return true;
+  }
+  if (total >= max_time_of(opts)) return true;
+  // Walking the histogram is not free, so the interval is checked after
+  // every 1/8 growth of the sample count.
+  if (samples.count() < p.next_check) return false;
+  p.next_check = samples.count() + samples.count() / 8 + 1;
+  auto const ci     = median_confidence_interval(samples);
+  auto const median = samples.at_rank(samples.count() / 2);
+  // No interval is narrow enough around a zero median, so that ends at the
+  // caps.
+  if (median == 0) return false;
+  return double(ci.high - ci.low) <= opts.precision * double(median);
+}
+
+template <typename C>
+template <typename Setup, typename Seq>
+void benchmark<C>::job_t<Setup, Seq>::prepare(reporter &r)
+{
+  if (opts.counters && !pmu) pmu.reset(new perf_counters);
+  if (opts.cold_cache && !evictor) evictor.reset(new cache_evictor);
+  keep_raw = r.wants_samples();
+}
+
+// Samples until the time spent on the point reaches until, or if this is the
+// last round, until it is enough.
+template <typename C>
+template <typename Setup, typename Seq>
+void benchmark<C>::job_t<Setup, Seq>::sample(point                      &p,
+                                             clock_calibration<C> const &clock,
+                                             typename C::duration       until,
+                                             bool                       last)
+{
+  if (p.batch == 0)
+  {
+    p.batch    = calibrate_batch(p);
+    p.evicting = { };
+    while (setups.size() > p.batch) setups.pop_back();
+    if (pmu) p.counter_samples.resize(num_counters);
+    p.raw.data_size  = data_size_of(p.size);
+    p.raw.batch_size = p.batch;
+    measurement dimensions{ };
+    set_parameters(dimensions, p.size);
+    p.raw.parameters.assign(dimensions.parameters,
+                            dimensions.parameters + dimensions.num_parameters);
+  }
+  if (opts.max_warmup != typename C::duration{ })
+  {
+    p.settled = warm_up(p, clock) && p.settled;
+  }
+  auto const first = p.samples.count();
+  while (last ? (p.samples.count() < 8
+                 || is_even(p.samples.count())
+                 || !enough(p))
+              : (p.samples.count() == first
+                 || p.total_duration + p.evicting < until))
+  {
+    auto const run_duration = time_batch(p, p.batch, true);
+    auto const net_duration = std::max(run_duration - read_overhead(clock),
+                                       typename C::duration{ });
+    p.total_duration += run_duration;
+    auto const per_call = static_cast<uint64_t>((net_duration / p.batch).count());
+    p.samples.record(per_call);
+    if (keep_raw) p.raw.durations.push_back(per_call);
+    if (pmu) record_counters(p);
+    if (timed_laps) record_laps(p, clock);
+  }
+  setups.clear();
+  prototype.reset();
+}
+
+template <typename C>
+template <typename Setup, typename Seq>
+measurement
+benchmark<C>::job_t<Setup, Seq>::finish(point                      &p,
+                                        reporter                   &r,
+                                        clock_calibration<C> const &clock)
+{
+  if (keep_raw)
+  {
+    for (auto &c : p.raw.counters)
+    {
+      if (c.size() != p.raw.durations.size()) c.clear();
+    }
+    r.samples(p.raw, job::name());
+  }
+  auto const num_samples = p.samples.count();
+  auto const resolution  = static_cast<uint64_t>(clock.resolution.count());
+  auto const batch       = p.batch;
+
+  measurement m = measurement_of(p.size, p.samples);
+  m.num_runs        = num_samples * batch;
+  m.batch_size      = batch;
+  m.near_resolution = m.median * batch < resolution_margin * resolution;
+  m.has_counters    = bool(pmu);
+  m.has_warmup      = opts.max_warmup != typename C::duration{ };
+  m.cold_cache      = opts.cold_cache;
+  if (m.has_warmup)
+  {
+    auto const warmup_count = p.warmup_samples.count();
+    m.warmup_runs    = warmup_count * batch;
+    m.warmup_median  = p.warmup_samples.at_rank(warmup_count / 2);
+    m.warmup_settled = p.settled;
+  }
+  for (std::size_t i = 0; pmu && i != num_counters; ++i)
+  {
+    if (p.counter_samples[i].count() == num_samples)
+    {
+      m.counters[i] = p.counter_samples[i].at_rank(num_samples / 2);
+    }
+  }
+  m.has_allocations = opts.allocations;
+  if (opts.allocations && allocation_hooks_installed())
+  {
+    auto const calls         = double(m.num_runs);
+    m.allocations_per_call   = double(p.allocated.allocations) / calls;
+    m.deallocations_per_call = double(p.allocated.deallocations) / calls;
+    m.bytes_per_call         = double(p.allocated.bytes) / calls;
+  }
+  using seconds = std::chrono::duration<double>;
+  auto const per_call = std::chrono::duration_cast<seconds>(
+    typename C::duration(m.median));
+  set_throughput<Setup>(m, p.size, per_call.count() > 0.0
+                                   ? 1.0 / per_call.count()
+                                   : std::numeric_limits<double>::infinity());
+  phase_results.resize(phases.size());
+  for (std::size_t i = 0; i != p.phase_samples.size(); ++i)
+  {
+    auto const &samples = p.phase_samples[i];
+    if (samples.count() == 0) continue;
+    measurement pm     = measurement_of(p.size, samples);
+    pm.num_runs        = samples.count() * batch;
+    pm.batch_size      = batch;
+    pm.near_resolution = pm.median * batch < resolution_margin * resolution;
+    phase_results[i].push_back(pm);
+  }
+  return m;
+}
+
+template <typename C>
+template <typename Setup, typename Seq>
+void benchmark<C>::job_t<Setup, Seq>::run(reporter                   &r,
+                                          clock_calibration<C> const &clock)
+{
+  result_sequence results;
+
+  prepare(r);
+  each_size(seq,
+            [&](size_type size) {
+              point p(size);
+              sample(p, clock, typename C::duration{ }, true);
+              results.push_back(finish(p, r, clock));
+              return results.back();
+            },
+            is_adaptive_seq<Seq>{ });
+  order_results<Seq>(results);
+  r.report(results, job::name());
+  report_phases(r);
+}
+
+template <typename C>
+template <typename Setup, typename Seq>
+std::size_t benchmark<C>::job_t<Setup, Seq>::prepare_rounds(reporter &r)
+{
+  // The sizes of adaptive sequences depend on the results, so they are not
+  // known up front.
+  if (is_adaptive_seq<Seq>::value) return 0;
+  prepare(r);
+  points.clear();
+  each_size(seq,
+            [&](size_type size) {
+              points.emplace_back(size);
+              return measurement{ };
+            },
+            is_adaptive_seq<Seq>{ });
+  return points.size();
+}
+
 template <typename C>
 template <typename Setup, typename Seq>
-void benchmark<C>::job_t<Setup, Seq>::run(reporter &r)
+void
+benchmark<C>::job_t<Setup, Seq>::run_round(std::size_t                index,
+                                           std::size_t                round,
+                                           std::size_t                rounds,
+                                           clock_calibration<C> const &clock)
 {
-  using namespace std::chrono_literals;
+  sample(points[index],
+         clock,
+         opts.min_time * (round + 1) / rounds,
+         round + 1 == rounds);
+}
 
+template <typename C>
+template <typename Setup, typename Seq>
+void
+benchmark<C>::job_t<Setup, Seq>::report_rounds(reporter                   &r,
+                                               clock_calibration<C> const &clock)
+{
+  result_sequence results;
+  for (auto &p : points) results.push_back(finish(p, r, clock));
+  points.clear();
+  r.report(results, job::name());
+  report_phases(r);
+}
+
+template <typename C>
+template <typename Setup, typename Seq, typename Threads>
+void
+benchmark<C>::threaded_job_t<Setup, Seq, Threads>::run(
+  reporter                   &r,
+  clock_calibration<C> const &clock)
+{
   result_sequence results;
 
   for (auto size : seq)
   {
-    std::vector<typename C::duration> measured_durations;
-    typename C::duration              total_duration{ };
-    while (total_duration < min_time
-        || measured_durations.size() < 8
-        || is_even(measured_durations.size()))
+    double single_thread_rate = 0.0;
+    for (std::size_t num_threads : threads)
     {
-      Setup setup(size);
+      if (num_threads == 0) continue;
 
-      auto const before = C::now();
-      setup(size);
-      auto const after = C::now();
+      Setup                    setup(size);
+      std::vector<histogram>   samples(num_threads);
+      std::vector<std::thread> workers;
+      // The workers block until all are started, instead of spinning, as
+      // spinning workers can keep the starting thread from running when
+      // there are no more CPUs than threads and the scheduling is FIFO.
+      std::mutex               start_mutex;
+      std::condition_variable  start_signal;
+      std::size_t              ready = 0;
+      bool                     go    = false;
 
-      auto const run_duration = after - before;
-      total_duration += run_duration;
-      measured_durations.push_back(run_duration);
-    }
-    std::sort(measured_durations.begin(), measured_durations.end());
-    auto const     num_runs = measured_durations.size();
-    auto const     lo_q_idx = num_runs / 4;
-    auto const     hi_q_idx = num_runs * 3 / 4;
-    auto const     qbegin   = measured_durations.begin() + lo_q_idx;
-    auto const     qend     = measured_durations.begin() + hi_q_idx;
-    auto const     sum      = std::accumulate(qbegin, qend, 0ns);
-    uint64_t const low_q    = measured_durations[lo_q_idx].count();
-    uint64_t const median   = measured_durations[num_runs / 2].count();
-    uint64_t const average  = sum.count() / (hi_q_idx - lo_q_idx);
-    uint64_t const high_q   = measured_durations[hi_q_idx].count();
-    measurement    m{ size, low_q, median, average, high_q, num_runs };
-    results.push_back(m);
+      for (std::size_t t = 0; t != num_threads; ++t)
+      {
+        workers.emplace_back([&, t] {
+          auto &h = samples[t];
+          typename C::duration total_duration{ };
+          {
+            std::unique_lock<std::mutex> lock(start_mutex);
+            ++ready;
+            start_signal.notify_all();
+            start_signal.wait(lock, [&] { return go; });
+          }
+          while (total_duration < min_time
+              || h.count() < 8
+              || is_even(h.count()))
+          {
+            auto const before = C::now();
+            setup(size);
+            auto const after = C::now();
+
+            typename C::duration const run_duration = after - before;
+            auto const net_duration = std::max(run_duration - clock.overhead,
+                                               typename C::duration{ });
+            total_duration += run_duration;
+            h.record(static_cast<uint64_t>(net_duration.count()));
+          }
+        });
+      }
+      typename C::time_point start;
+      {
+        std::unique_lock<std::mutex> lock(start_mutex);
+        start_signal.wait(lock, [&] { return ready == num_threads; });
+        start = C::now();
+        go    = true;
+      }
+      start_signal.notify_all();
+      for (auto &w : workers) w.join();
+      auto const end = C::now();
+
+      for (std::size_t t = 1; t != num_threads; ++t)
+      {
+        samples[0].merge(samples[t]);
+      }
+      using seconds = std::chrono::duration<double>;
+      auto const wall = std::chrono::duration_cast<seconds>(
+        typename C::duration(end - start));
+
+      measurement m = measurement_of(size, samples[0]);
+      m.threads            = num_threads;
+      m.ops_per_second     = wall.count() > 0.0
+                           ? double(m.num_runs) / wall.count()
+                           : 0.0;
+      if (single_thread_rate == 0.0)
+      {
+        single_thread_rate = m.ops_per_second / double(num_threads);
+      }
+      m.scaling_efficiency = single_thread_rate > 0.0
+                           ? m.ops_per_second / double(num_threads)
+                             / single_thread_rate
+                           : 0.0;
+      set_throughput<Setup>(m, size, m.ops_per_second);
+      results.push_back(m);
+    }
   }
   r.report(results, job::name());
 }
 
+
+template <typename C>
+template <typename SetupA, typename SetupB, typename Seq>
+bool
+benchmark<C>::compare_job_t<SetupA, SetupB, Seq>::enough(
+  std::vector<double> const &speedups,
+  typename C::duration      total,
+  uint64_t                  &next_check) const
+{
+  if (total < opts.min_time) return false;
+  if (opts.precision <= 0.0) return true;
+  // Each speedup is of two calls of each setup.
+  if (opts.max_runs != 0 && 2 * speedups.size() >= opts.max_runs) return true;
+  if (total >= max_time_of(opts)) return true;
+  if (speedups.size() < next_check) return false;
+  next_check = speedups.size() + speedups.size() / 8 + 1;
+  auto sorted = speedups;
+  std::sort(sorted.begin(), sorted.end());
+  auto const ranks  = median_confidence_ranks(sorted.size());
+  auto const median = sorted[sorted.size() / 2];
+  if (!(median > 0.0)) return false;
+  return sorted[ranks.high] - sorted[ranks.low] <= opts.precision * median;
+}
+
+template <typename C>
+template <typename SetupA, typename SetupB, typename Seq>
+void
+benchmark<C>::compare_job_t<SetupA, SetupB, Seq>::run(
+  reporter                   &r,
+  clock_calibration<C> const &clock)
+{
+  using seeded_a = std::is_constructible<SetupA, size_type const&, seed_type>;
+  using seeded_b = std::is_constructible<SetupB, size_type const&, seed_type>;
+
+  auto const resolution = static_cast<uint64_t>(clock.resolution.count());
+  auto const time_call = [&](auto &setup, size_type const &size) {
+    auto const before = C::now();
+    setup(size);
+    auto const after = C::now();
+    return typename C::duration(after - before);
+  };
+  auto const net_ticks = [&](typename C::duration d) {
+    return static_cast<uint64_t>(
+      std::max(d - clock.overhead, typename C::duration{ }).count());
+  };
+  auto const summary = [&](size_type const &size, histogram const &samples) {
+    measurement m     = measurement_of(size, samples);
+    m.near_resolution = m.median < resolution_margin * resolution;
+    return m;
+  };
+  auto const calls_per_second = [](measurement const &m) {
+    using seconds = std::chrono::duration<double>;
+    auto const per_call = std::chrono::duration_cast<seconds>(
+      typename C::duration(m.median));
+    return per_call.count() > 0.0 ? 1.0 / per_call.count()
+                                  : std::numeric_limits<double>::infinity();
+  };
+
+  std::mt19937    seeds(std::random_device{}());
+  result_sequence results_a;
+  result_sequence results_b;
+  each_size(seq,
+            [&](size_type size) {
+              histogram            samples_a;
+              histogram            samples_b;
+              std::vector<double>  speedups;
+              typename C::duration total{ };
+              uint64_t             next_check = 0;
+              while (speedups.size() < 9
+                     || is_even(speedups.size())
+                     || !enough(speedups, total, next_check))
+              {
+                // Each speedup is of a pair with A called first, and one
+                // with B called first, which cancels out what the first call
+                // leaves behind for the second, like warm caches.
+                uint64_t sum_a = 0;
+                uint64_t sum_b = 0;
+                for (bool a_first : { true, false })
+                {
+                  auto const seed = static_cast<seed_type>(seeds());
+                  auto       a    = make_setup<SetupA>(size, seed, seeded_a{ });
+                  auto       b    = make_setup<SetupB>(size, seed, seeded_b{ });
+                  typename C::duration duration_a;
+                  typename C::duration duration_b;
+                  if (a_first)
+                  {
+                    duration_a = time_call(*a, size);
+                    duration_b = time_call(*b, size);
+                  }
+                  else
+                  {
+                    duration_b = time_call(*b, size);
+                    duration_a = time_call(*a, size);
+                  }
+                  total += duration_a + duration_b;
+                  auto const ticks_a = net_ticks(duration_a);
+                  auto const ticks_b = net_ticks(duration_b);
+                  samples_a.record(ticks_a);
+                  samples_b.record(ticks_b);
+                  sum_a += ticks_a;
+                  sum_b += ticks_b;
+                }
+                // Less than a tick cannot be told apart from a tick.
+                speedups.push_back(double(std::max<uint64_t>(sum_a, 1))
+                                   / double(std::max<uint64_t>(sum_b, 1)));
+              }
+              std::sort(speedups.begin(), speedups.end());
+              auto const ranks = median_confidence_ranks(speedups.size());
+
+              auto m_a = summary(size, samples_a);
+              auto m_b = summary(size, samples_b);
+              set_throughput<SetupA>(m_a, size, calls_per_second(m_a));
+              set_throughput<SetupB>(m_b, size, calls_per_second(m_b));
+              m_b.has_speedup  = true;
+              m_b.speedup      = speedups[speedups.size() / 2];
+              m_b.speedup_low  = speedups[ranks.low];
+              m_b.speedup_high = speedups[ranks.high];
+              results_a.push_back(m_a);
+              results_b.push_back(m_b);
+              return m_b;
+            },
+            is_adaptive_seq<Seq>{ });
+  order_results<Seq>(results_a);
+  order_results<Seq>(results_b);
+  r.report(results_a, name_a);
+  r.report(results_b, name_b);
+}
+
 }
 
 #endif //TACHYMETER_BENCHMARK_HPP
@@ -0,0 +1,254 @@
+/*
+ * Tachymeter C++ micro benchmark
+ *
+ * Copyright Björn Fahller 2015
+ *
+ *  Use, modification and distribution is subject to the
+ *  Boost Software License, Version 1.0. (See accompanying
+ *  file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ *
+ * Project home: https://github.com/rollbear/tachymeter
+ */
+
+#ifndef TACHYMETER_BINARY_REPORTER_HPP
+#define TACHYMETER_BINARY_REPORTER_HPP
+
+#include "reporter.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace tachymeter
+{
+
+// Raw samples are written to one file per job, <dir>/<name>.samples, laid out
+// for memory mapping:
+//
+//   "TACHYSMP", version, number of size points       3 x 8 bytes
+//   one index entry per size point:                  26 x 8 bytes
+//     data size, batch size, number of samples,
+//     number of parameters, max_parameters parameters,
+//     offset and length of the durations column,
+//     offset and length of each counter column
+//   the columns
+//
+// All header and index fields are 64 bit little endian, offsets are from the
+// start of the file, and absent columns and parameters have length 0.
+// Parameters past their number are 0. In a column, each
+// value is the zigzag encoded difference to the one before it, as a LEB128
+// varint, so the typical sample takes a byte or two.
+namespace sample_file
+{
+
+constexpr char        magic[8] = { 'T','A','C','H','Y','S','M','P' };
+constexpr uint64_t    version = 2;
+constexpr std::size_t num_columns = 1 + num_counters;
+constexpr std::size_t header_size = 3 * 8;
+constexpr std::size_t parameters_offset = 4 * 8;
+constexpr std::size_t columns_offset = parameters_offset + max_parameters * 8;
+constexpr std::size_t entry_size = columns_offset + 2 * num_columns * 8;
+
+inline void put_fixed(std::string &out, uint64_t v)
+{
+  for (int i = 0; i != 8; ++i) out += char((v >> (8 * i)) & 0xff);
+}
+
+inline uint64_t get_fixed(unsigned char const *p)
+{
+  uint64_t v = 0;
+  for (int i = 8; i-- != 0;) v = (v << 8) | p[i];
+  return v;
+}
+
+inline void encode_column(std::vector<uint64_t> const &values, std::string &out)
+{
+  uint64_t prev = 0;
+  for (auto v : values)
+  {
+    auto const delta = static_cast<int64_t>(v - prev);
+    auto zigzag = (static_cast<uint64_t>(delta) << 1)
+                ^ static_cast<uint64_t>(delta >> 63);
+    prev = v;
+    while (zigzag >= 0x80)
+    {
+      out += char((zigzag & 0x7f) | 0x80);
+      zigzag >>= 7;
+    }
+    out += char(zigzag);
+  }
+}
+
+// Decodes a column into values. Returns false if it is malformed.
+inline bool decode_column(unsigned char const *first,
+                          unsigned char const *last,
+                          std::vector<uint64_t> &values)
+{
+  uint64_t prev = 0;
+  while (first != last)
+  {
+    uint64_t zigzag = 0;
+    for (unsigned shift = 0;; shift += 7)
+    {
+      if (first == last || shift > 63) return false;
+      auto const byte = *first++;
+      zigzag |= uint64_t(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) break;
+    }
+    prev += (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+    values.push_back(prev);
+  }
+  return true;
+}
+
+// Decodes a whole file. Returns false if it could not be read or is
+// malformed.
+inline bool read(std::string const &path, std::vector<raw_samples> &points)
+{
+  std::ifstream in(path, std::ios::binary);
+  std::vector<unsigned char> const data{ std::istreambuf_iterator<char>(in),
+                                         std::istreambuf_iterator<char>() };
+  if (data.size() < header_size
+      || !std::equal(magic, magic + 8, data.begin())
+      || get_fixed(&data[8]) != version)
+  {
+    return false;
+  }
+  auto const count = get_fixed(&data[16]);
+  if ((data.size() - header_size) / entry_size < count) return false;
+  for (uint64_t i = 0; i != count; ++i)
+  {
+    auto const entry = &data[header_size + i * entry_size];
+    raw_samples s;
+    s.data_size  = get_fixed(entry);
+    s.batch_size = get_fixed(entry + 8);
+    auto const num_parameters = get_fixed(entry + 24);
+    if (num_parameters > max_parameters) return false;
+    for (std::size_t p = 0; p != num_parameters; ++p)
+    {
+      s.parameters.push_back(get_fixed(entry + parameters_offset + p * 8));
+    }
+    for (std::size_t c = 0; c != num_columns; ++c)
+    {
+      auto const offset = get_fixed(entry + columns_offset + c * 16);
+      auto const length = get_fixed(entry + columns_offset + 8 + c * 16);
+      if (offset > data.size() || data.size() - offset < length) return false;
+      auto &values = c == 0 ? s.durations : s.counters[c - 1];
+      auto const first = data.data() + offset;
+      if (!decode_column(first, first + length, values)) return false;
+    }
+    if (s.durations.size() != get_fixed(entry + 16)) return false;
+    points.push_back(std::move(s));
+  }
+  return true;
+}
+
+}
+
+// Writes the raw samples of every job to a sample file in dir, and passes
+// all calls on to next, if given. Results reported without raw samples for
+// their name, like those of comparisons, threaded jobs and phases, get no
+// file.
+class binary_reporter : public reporter
+{
+public:
+  binary_reporter(const char* dir, reporter *next_ = nullptr)
+      : out_dir{dir}
+      , next{next_}
+  { }
+  void report(result_sequence const &results, std::string const &name) override;
+  void info(std::string const &key, std::string const &value) override
+  {
+    if (next) next->info(key, value);
+  }
+  bool wants_samples() const override { return true; }
+  void samples(raw_samples const &s, std::string const &name) override;
+private:
+  struct point
+  {
+    uint64_t    data_size;
+    uint64_t    batch_size;
+    uint64_t    count;
+    std::vector<uint64_t> parameters;
+    std::string columns[sample_file::num_columns];
+  };
+  const char*        out_dir;
+  reporter           *next;
+  std::string        job_name;
+  std::vector<point> points;
+};
+
+inline
+void binary_reporter::samples(raw_samples const &s, std::string const &name)
+{
+  if (name != job_name)
+  {
+    points.clear();
+    job_name = name;
+  }
+  points.push_back({ s.data_size,
+                     s.batch_size,
+                     s.durations.size(),
+                     s.parameters,
+                     { } });
+  auto &p = points.back();
+  sample_file::encode_column(s.durations, p.columns[0]);
+  for (std::size_t i = 0; i != num_counters; ++i)
+  {
+    sample_file::encode_column(s.counters[i], p.columns[i + 1]);
+  }
+  if (next) next->samples(s, name);
+}
+
+inline
+void binary_reporter::report(result_sequence const &results,
+                             std::string const &name)
+{
+  using namespace sample_file;
+  if (name != job_name || points.empty())
+  {
+    if (next) next->report(results, name);
+    return;
+  }
+
+  std::string header(magic, sizeof(magic));
+  put_fixed(header, version);
+  put_fixed(header, points.size());
+  uint64_t offset = header_size + points.size() * entry_size;
+  for (auto const &p : points)
+  {
+    put_fixed(header, p.data_size);
+    put_fixed(header, p.batch_size);
+    put_fixed(header, p.count);
+    auto const num_parameters = std::min(p.parameters.size(), max_parameters);
+    put_fixed(header, num_parameters);
+    for (std::size_t i = 0; i != max_parameters; ++i)
+    {
+      put_fixed(header, i < num_parameters ? p.parameters[i] : 0);
+    }
+    for (auto const &c : p.columns)
+    {
+      put_fixed(header, offset);
+      put_fixed(header, c.size());
+      offset += c.size();
+    }
+  }
+  std::ofstream out(out_dir + ("/" + name) + ".samples", std::ios::binary);
+  out << header;
+  for (auto const &p : points)
+  {
+    for (auto const &c : p.columns) out << c;
+  }
+  points.clear();
+  job_name.clear();
+
+  if (next) next->report(results, name);
+}
+
+}
+
+#endif //TACHYMETER_BINARY_REPORTER_HPP
@@ -0,0 +1,99 @@
+/*
+ * Tachymeter C++ micro benchmark
+ *
+ * Copyright Björn Fahller 2015
+ *
+ *  Use, modification and distribution is subject to the
+ *  Boost Software License, Version 1.0. (See accompanying
+ *  file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ *
+ * Project home: https://github.com/rollbear/tachymeter
+ */
+
+#ifndef TACHYMETER_CACHE_HPP
+#define TACHYMETER_CACHE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace tachymeter
+{
+
+// The sizes in bytes of the data caches of the first CPU, one per level, in
+// increasing order of level. Empty where they cannot be found.
+inline std::vector<std::size_t> data_cache_sizes()
+{
+  std::vector<std::pair<int, std::size_t>> levels;
+#if defined(__linux__)
+  for (int index = 0;; ++index)
+  {
+    auto const dir = "/sys/devices/system/cpu/cpu0/cache/index"
+                   + std::to_string(index) + '/';
+    std::ifstream level_file(dir + "level");
+    std::ifstream type_file(dir + "type");
+    std::ifstream size_file(dir + "size");
+    int           level = 0;
+    std::string   type;
+    std::string   size;
+    if (!(level_file >> level) || !(type_file >> type) || !(size_file >> size))
+    {
+      break;
+    }
+    if (type == "Instruction") continue;
+    char *end;
+    std::size_t bytes = std::strtoul(size.c_str(), &end, 10);
+    if (*end == 'K') bytes <<= 10;
+    else if (*end == 'M') bytes <<= 20;
+    else if (*end == 'G') bytes <<= 30;
+    if (bytes != 0) levels.emplace_back(level, bytes);
+  }
+#endif
+  std::sort(levels.begin(), levels.end());
+  std::vector<std::size_t> rv;
+  for (auto const &l : levels) rv.push_back(l.second);
+  return rv;
+}
+
+// The size in bytes of the cache lines of the first CPU, or 64 if it cannot
+// be found.
+inline std::size_t cache_line_size()
+{
+  std::size_t size = 0;
+#if defined(__linux__)
+  std::ifstream in("/sys/devices/system/cpu/cpu0/cache/index0/coherency_line_size");
+  in >> size;
+#endif
+  return size != 0 ? size : 64;
+}
+
+// Evicts the data of earlier accesses from all cache levels, by writing to
+// every cache line of a buffer twice the size of the last level cache, or of
+// 64MiB if it is not known.
+class cache_evictor
+{
+public:
+  cache_evictor()
+    : line_size(cache_line_size())
+  {
+    auto const sizes = data_cache_sizes();
+    buffer.resize(2 * (sizes.empty() ? std::size_t{ 32 } << 20 : sizes.back()));
+  }
+  void evict()
+  {
+    volatile unsigned char *p = buffer.data();
+    for (std::size_t i = 0; i < buffer.size(); i += line_size) p[i] = p[i] + 1;
+  }
+  std::size_t size() const { return buffer.size(); }
+private:
+  std::size_t                line_size;
+  std::vector<unsigned char> buffer;
+};
+
+}
+
+#endif //TACHYMETER_CACHE_HPP
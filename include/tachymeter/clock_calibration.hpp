@@ -0,0 +1,76 @@
+/*
+ * Tachymeter C++ micro benchmark
+ *
+ * Copyright Björn Fahller 2015
+ *
+ *  Use, modification and distribution is subject to the
+ *  Boost Software License, Version 1.0. (See accompanying
+ *  file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ *
+ * Project home: https://github.com/rollbear/tachymeter
+ */
+
+#ifndef TACHYMETER_CLOCK_CALIBRATION_HPP
+#define TACHYMETER_CLOCK_CALIBRATION_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace tachymeter
+{
+
+template <typename C>
+struct clock_calibration
+{
+  // The time measured between two back to back reads of the clock, i.e. the
+  // cost of the timing itself included in every measured duration.
+  typename C::duration overhead;
+  // The smallest observable step of the clock, or zero if the clock was never
+  // seen to advance.
+  typename C::duration resolution;
+};
+
+template <typename C>
+clock_calibration<C> calibrate_clock()
+{
+  constexpr std::size_t overhead_samples   = 63;
+  constexpr std::size_t resolution_steps   = 5;
+  constexpr std::size_t max_reads_per_step = std::size_t{1} << 20;
+
+  std::vector<typename C::duration> overheads;
+  overheads.reserve(overhead_samples);
+  for (std::size_t i = 0; i != overhead_samples; ++i)
+  {
+    auto const before = C::now();
+    auto const after = C::now();
+    overheads.push_back(after - before);
+  }
+  auto const median = overheads.begin() + overhead_samples / 2;
+  std::nth_element(overheads.begin(), median, overheads.end());
+
+  typename C::duration resolution{ };
+  auto prev = C::now();
+  for (std::size_t step = 0; step != resolution_steps; ++step)
+  {
+    auto now = C::now();
+    for (std::size_t n = 0; now == prev && n != max_reads_per_step; ++n)
+    {
+      now = C::now();
+    }
+    if (now == prev) break;
+    typename C::duration const diff = now - prev;
+    // The first step starts at an arbitrary point within a tick.
+    if (step > 0 && (resolution == typename C::duration{ } || diff < resolution))
+    {
+      resolution = diff;
+    }
+    prev = now;
+  }
+  return { *median, resolution };
+}
+
+}
+
+#endif //TACHYMETER_CLOCK_CALIBRATION_HPP
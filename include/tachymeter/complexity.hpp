@@ -0,0 +1,280 @@
+/*
+ * Tachymeter C++ micro benchmark
+ *
+ * Copyright Björn Fahller 2015
+ *
+ *  Use, modification and distribution is subject to the
+ *  Boost Software License, Version 1.0. (See accompanying
+ *  file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ *
+ * Project home: https://github.com/rollbear/tachymeter
+ */
+
+#ifndef TACHYMETER_COMPLEXITY_HPP
+#define TACHYMETER_COMPLEXITY_HPP
+
+#include "reporter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace tachymeter
+{
+
+// In order of growth. none means no complexity is expected.
+enum class complexity
+{
+  none,
+  constant,
+  logarithmic,
+  linear,
+  n_log_n,
+  quadratic,
+  power_law
+};
+
+inline const char* complexity_name(complexity c)
+{
+  static const char* const names[] = {
+    "none", "O(1)", "O(log n)", "O(n)", "O(n log n)", "O(n^2)", "O(n^k)"
+  };
+  return names[static_cast<std::size_t>(c)];
+}
+
+// median ~ coefficient * f(size), where f is given by kind, and is
+// size^exponent for a power law. The error is the root mean square of the
+// residuals, relative to the mean of the medians.
+struct complexity_fit
+{
+  complexity kind;
+  double     coefficient;
+  double     exponent;
+  double     error;
+};
+
+namespace detail
+{
+
+inline double complexity_term(complexity c, double n, double exponent)
+{
+  switch (c)
+  {
+    case complexity::constant:    return 1.0;
+    case complexity::logarithmic: return std::log2(n);
+    case complexity::linear:      return n;
+    case complexity::n_log_n:     return n * std::log2(n);
+    case complexity::quadratic:   return n * n;
+    case complexity::power_law:   return std::pow(n, exponent);
+    case complexity::none:        break;
+  }
+  return 0.0;
+}
+
+inline double fit_error(result_sequence const &results,
+                        complexity_fit const  &fit)
+{
+  double sum_sq = 0.0;
+  double sum_y  = 0.0;
+  for (auto const &m : results)
+  {
+    auto const y = double(m.median);
+    auto const f = complexity_term(fit.kind, double(m.data_size), fit.exponent);
+    sum_sq += (y - fit.coefficient * f) * (y - fit.coefficient * f);
+    sum_y  += y;
+  }
+  auto const n = double(results.size());
+  return sum_y > 0.0 ? std::sqrt(sum_sq / n) / (sum_y / n) : 0.0;
+}
+
+}
+
+// Least squares fits of the medians to each complexity, ordered by growth.
+// The power law is fitted as a straight line in log-log space. Sizes of 0
+// are ignored, and fewer than 3 sizes give no fits.
+inline std::vector<complexity_fit> fit_complexities(result_sequence results)
+{
+  results.erase(std::remove_if(results.begin(), results.end(),
+                               [](measurement const &m) {
+                                 return m.data_size == 0;
+                               }),
+                results.end());
+  std::vector<complexity_fit> fits;
+  if (results.size() < 3) return fits;
+
+  for (auto kind : { complexity::constant, complexity::logarithmic,
+                     complexity::linear, complexity::n_log_n,
+                     complexity::quadratic })
+  {
+    double sum_yf = 0.0;
+    double sum_ff = 0.0;
+    for (auto const &m : results)
+    {
+      auto const f = detail::complexity_term(kind, double(m.data_size), 0.0);
+      sum_yf += double(m.median) * f;
+      sum_ff += f * f;
+    }
+    complexity_fit fit{ kind, sum_ff > 0.0 ? sum_yf / sum_ff : 0.0, 0.0, 0.0 };
+    fit.error = detail::fit_error(results, fit);
+    fits.push_back(fit);
+  }
+
+  double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0, count = 0.0;
+  for (auto const &m : results)
+  {
+    if (m.median == 0) continue;
+    auto const x = std::log(double(m.data_size));
+    auto const y = std::log(double(m.median));
+    sx += x; sy += y; sxx += x * x; sxy += x * y; count += 1.0;
+  }
+  auto const denominator = count * sxx - sx * sx;
+  if (count >= 3.0 && denominator > 0.0)
+  {
+    auto const k = (count * sxy - sx * sy) / denominator;
+    complexity_fit fit{ complexity::power_law,
+                        std::exp((sy - k * sx) / count), k, 0.0 };
+    fit.error = detail::fit_error(results, fit);
+    fits.push_back(fit);
+  }
+  return fits;
+}
+
+// The fit with the least error. The power law has a free exponent, so it
+// must halve the error of the best of the others to be chosen.
+inline complexity_fit best_complexity(std::vector<complexity_fit> const &fits)
+{
+  complexity_fit best{ complexity::none, 0.0, 0.0, 0.0 };
+  for (auto const &f : fits)
+  {
+    if (best.kind == complexity::none
+        || (f.kind == complexity::power_law ? f.error * 2 : f.error) < best.error)
+    {
+      best = f;
+    }
+  }
+  return best;
+}
+
+// The exponent a power law may have and still be of complexity c.
+inline double max_exponent(complexity c)
+{
+  switch (c)
+  {
+    case complexity::constant:    return 0.25;
+    case complexity::logarithmic: return 0.5;
+    case complexity::linear:      return 1.25;
+    case complexity::n_log_n:     return 1.5;
+    case complexity::quadratic:   return 2.25;
+    default:                      return HUGE_VAL;
+  }
+}
+
+// Forwards all results to another reporter, and fits the medians of the jobs
+// named with expect() to the complexities, printing the best fit and the time
+// per element of every size. A job whose best fit grows faster than the
+// complexity expected for it fails.
+class complexity_reporter : public reporter
+{
+public:
+  complexity_reporter(reporter &next_, std::ostream &os_)
+    : next(next_)
+    , os(os_)
+  {
+  }
+  void expect(std::string const &name, complexity c = complexity::none)
+  {
+    expected[name] = c;
+  }
+  void report(result_sequence const &results, std::string const &name) override;
+  void info(std::string const &key, std::string const &value) override
+  {
+    next.info(key, value);
+  }
+  bool wants_samples() const override { return next.wants_samples(); }
+  void samples(raw_samples const &s, std::string const &name) override
+  {
+    next.samples(s, name);
+  }
+  bool failed() const { return failure; }
+private:
+  reporter                           &next;
+  std::ostream                       &os;
+  std::map<std::string, complexity>  expected;
+  bool                               failure = false;
+};
+
+inline
+void complexity_reporter::report(result_sequence const &results,
+                                 std::string const &name)
+{
+  next.report(results, name);
+
+  auto const i = expected.find(name);
+  // Thread counts and further dimensions are not sizes, so scalability and
+  // multi-dimensional results are not fitted.
+  if (i == expected.end()
+      || std::any_of(results.begin(), results.end(),
+                     [](measurement const &m) {
+                       return m.threads != 0 || m.num_parameters > 1;
+                     }))
+  {
+    return;
+  }
+  auto const want = i->second;
+  auto const fits = fit_complexities(results);
+  if (fits.empty())
+  {
+    os << name << ": too few sizes to fit a complexity\n";
+    return;
+  }
+  auto const best = best_complexity(fits);
+  auto const term = [](complexity_fit const &f) -> std::string {
+    switch (f.kind)
+    {
+      case complexity::constant:    return "";
+      case complexity::logarithmic: return " * log n";
+      case complexity::linear:      return " * n";
+      case complexity::n_log_n:     return " * n log n";
+      case complexity::quadratic:   return " * n^2";
+      default:                      break;
+    }
+    std::ostringstream s;
+    s << std::setprecision(3) << " * n^" << f.exponent;
+    return s.str();
+  };
+
+  auto const precision = os.precision(3);
+  os << name << ": " << complexity_name(best.kind)
+     << ' ' << best.coefficient << term(best) << ", rms error "
+     << best.error * 100 << '%';
+  if (best.kind != complexity::power_law && fits.back().kind == complexity::power_law)
+  {
+    os << ", power law n^" << fits.back().exponent;
+  }
+  if (want != complexity::none && want != complexity::power_law)
+  {
+    bool const ok = best.kind == complexity::power_law
+                  ? best.exponent <= max_exponent(want)
+                  : best.kind <= want;
+    os << ", expected " << complexity_name(want) << (ok ? "" : " FAILED");
+    failure = failure || !ok;
+  }
+  os << '\n';
+  for (auto const &m : results)
+  {
+    if (m.data_size == 0) continue;
+    os << name << ' ' << m.data_size << ": "
+       << double(m.median) / double(m.data_size) << " per element\n";
+  }
+  os.precision(precision);
+}
+
+}
+
+#endif //TACHYMETER_COMPLEXITY_HPP
@@ -0,0 +1,252 @@
+/*
+ * Tachymeter C++ micro benchmark
+ *
+ * Copyright Björn Fahller 2015
+ *
+ *  Use, modification and distribution is subject to the
+ *  Boost Software License, Version 1.0. (See accompanying
+ *  file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ *
+ * Project home: https://github.com/rollbear/tachymeter
+ */
+
+#ifndef TACHYMETER_HISTOGRAM_HPP
+#define TACHYMETER_HISTOGRAM_HPP
+
+#include "measurement.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace tachymeter
+{
+
+namespace detail
+{
+
+inline unsigned most_significant_bit(uint64_t v)
+{
+#if defined(__GNUC__)
+  return 63U - static_cast<unsigned>(__builtin_clzll(v));
+#else
+  unsigned rv = 0;
+  while (v >>= 1) ++rv;
+  return rv;
+#endif
+}
+
+}
+
+// The number of buckets, and the bucket of a value, of histograms of the
+// given precision.
+constexpr std::size_t histogram_buckets(unsigned precision_bits)
+{
+  return std::size_t{66U - precision_bits} << (precision_bits - 1);
+}
+
+inline std::size_t histogram_index(uint64_t value, unsigned precision_bits)
+{
+  if (value < (uint64_t{1} << precision_bits)) return value;
+  auto const shift = detail::most_significant_bit(value) - (precision_bits - 1);
+  return (std::size_t{shift} << (precision_bits - 1)) + (value >> shift);
+}
+
+// Log-linear bucketed histogram of unsigned values, in the style of HDR
+// histograms. Values below 2^precision_bits are recorded exactly, larger
+// values in buckets whose width is at most 1/2^(precision_bits - 1) of the
+// value. Memory use is fixed by the precision, recording is O(1), and rank
+// queries are O(number of buckets).
+class histogram
+{
+public:
+  explicit histogram(unsigned precision_bits = 7);
+  void        record(uint64_t value);
+  void        add(std::size_t index, uint64_t num);
+  // Adds all samples of another histogram of the same precision.
+  void        merge(histogram const &other);
+  void        clear();
+  uint64_t    count() const { return total; }
+  uint64_t    min() const { return smallest; }
+  uint64_t    max() const { return largest; }
+  // The value of the sample with the given 0 based rank in sorted order.
+  uint64_t    at_rank(uint64_t rank) const;
+  // The average of the samples with ranks in [first_rank, last_rank).
+  uint64_t    mean(uint64_t first_rank, uint64_t last_rank) const;
+  std::size_t index_of(uint64_t value) const;
+  uint64_t    value_of(std::size_t index) const;
+  std::size_t size() const { return buckets.size(); }
+  uint64_t    operator[](std::size_t index) const { return buckets[index]; }
+private:
+  uint64_t              midpoint_of(std::size_t index) const;
+  unsigned              bits;
+  std::vector<uint64_t> buckets;
+  uint64_t              total    = 0;
+  uint64_t              smallest = std::numeric_limits<uint64_t>::max();
+  uint64_t              largest  = 0;
+};
+
+inline
+histogram::histogram(unsigned precision_bits)
+  : bits(precision_bits)
+  , buckets(histogram_buckets(precision_bits))
+{
+}
+
+inline
+std::size_t histogram::index_of(uint64_t value) const
+{
+  return histogram_index(value, bits);
+}
+
+inline
+uint64_t histogram::midpoint_of(std::size_t index) const
+{
+  if (index < (std::size_t{1} << bits)) return index;
+  auto const shift = (index >> (bits - 1)) - 1;
+  auto const lower = static_cast<uint64_t>(index - (shift << (bits - 1))) << shift;
+  return lower + ((uint64_t{1} << shift) - 1) / 2;
+}
+
+inline
+uint64_t histogram::value_of(std::size_t index) const
+{
+  return std::min(std::max(midpoint_of(index), smallest), largest);
+}
+
+inline
+void histogram::record(uint64_t value)
+{
+  ++buckets[index_of(value)];
+  ++total;
+  smallest = std::min(smallest, value);
+  largest = std::max(largest, value);
+}
+
+inline
+void histogram::add(std::size_t index, uint64_t num)
+{
+  if (num == 0) return;
+  buckets[index] += num;
+  total += num;
+  auto const value = midpoint_of(index);
+  smallest = std::min(smallest, value);
+  largest = std::max(largest, value);
+}
+
+inline
+void histogram::merge(histogram const &other)
+{
+  for (std::size_t i = 0; i != buckets.size(); ++i)
+  {
+    buckets[i] += other.buckets[i];
+  }
+  total += other.total;
+  smallest = std::min(smallest, other.smallest);
+  largest = std::max(largest, other.largest);
+}
+
+inline
+void histogram::clear()
+{
+  std::fill(buckets.begin(), buckets.end(), uint64_t{0});
+  total = 0;
+  smallest = std::numeric_limits<uint64_t>::max();
+  largest = 0;
+}
+
+inline
+uint64_t histogram::at_rank(uint64_t rank) const
+{
+  uint64_t seen = 0;
+  for (std::size_t i = 0; i != buckets.size(); ++i)
+  {
+    seen += buckets[i];
+    if (seen > rank) return value_of(i);
+  }
+  return largest;
+}
+
+inline
+uint64_t histogram::mean(uint64_t first_rank, uint64_t last_rank) const
+{
+  if (last_rank <= first_rank) return at_rank(first_rank);
+  uint64_t seen = 0;
+  uint64_t sum = 0;
+  for (std::size_t i = 0; i != buckets.size() && seen < last_rank; ++i)
+  {
+    auto const lo = std::max(seen, first_rank);
+    seen += buckets[i];
+    auto const hi = std::min(seen, last_rank);
+    if (hi > lo) sum += (hi - lo) * value_of(i);
+  }
+  return sum / (last_rank - first_rank);
+}
+
+struct interval
+{
+  uint64_t low;
+  uint64_t high;
+};
+
+// The ranks of the order statistics n/2 -+ 1.96*sqrt(n)/2 of n values,
+// which bound a distribution free 95% confidence interval of the median.
+inline
+interval median_confidence_ranks(uint64_t count)
+{
+  if (count == 0) return { 0, 0 };
+  auto const n    = static_cast<double>(count);
+  auto const half = 1.96 * std::sqrt(n) / 2;
+  auto const lo   = std::floor(std::max(n / 2 - half, 0.0));
+  auto const hi   = std::ceil(std::min(n / 2 + half, n - 1));
+  return { static_cast<uint64_t>(lo), static_cast<uint64_t>(hi) };
+}
+
+// Distribution free 95% confidence interval of the median.
+inline
+interval median_confidence_interval(histogram const &h)
+{
+  if (h.count() == 0) return { 0, 0 };
+  auto const ranks = median_confidence_ranks(h.count());
+  return { h.at_rank(ranks.low), h.at_rank(ranks.high) };
+}
+
+// The statistics of the samples, as the measurement of size 0 with one
+// call per sample.
+inline
+measurement summary_of(histogram const &samples)
+{
+  auto const num_samples = samples.count();
+  auto const lo_q_rank   = num_samples / 4;
+  auto const hi_q_rank   = num_samples * 3 / 4;
+  auto const median_ci   = median_confidence_interval(samples);
+
+  measurement m{ };
+  m.lower_quartile         = samples.at_rank(lo_q_rank);
+  m.median                 = samples.at_rank(num_samples / 2);
+  m.average                = samples.mean(lo_q_rank, hi_q_rank);
+  m.upper_quartile         = samples.at_rank(hi_q_rank);
+  m.num_runs               = num_samples;
+  m.batch_size             = 1;
+  m.percentile_90          = samples.at_rank(num_samples * 9 / 10);
+  m.percentile_99          = samples.at_rank(num_samples * 99 / 100);
+  m.percentile_99_9        = samples.at_rank(num_samples * 999 / 1000);
+  m.maximum                = samples.max();
+  m.median_low             = median_ci.low;
+  m.median_high            = median_ci.high;
+  m.allocations_per_call   = std::numeric_limits<double>::quiet_NaN();
+  m.deallocations_per_call = std::numeric_limits<double>::quiet_NaN();
+  m.bytes_per_call         = std::numeric_limits<double>::quiet_NaN();
+  m.items_per_second       = std::numeric_limits<double>::quiet_NaN();
+  m.bytes_per_second       = std::numeric_limits<double>::quiet_NaN();
+  std::fill(std::begin(m.counters), std::end(m.counters), counter_unavailable);
+  return m;
+}
+
+}
+
+#endif //TACHYMETER_HISTOGRAM_HPP
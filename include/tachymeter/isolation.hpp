@@ -0,0 +1,286 @@
+/*
+ * Tachymeter C++ micro benchmark
+ *
+ * Copyright Björn Fahller 2015
+ *
+ *  Use, modification and distribution is subject to the
+ *  Boost Software License, Version 1.0. (See accompanying
+ *  file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ *
+ * Project home: https://github.com/rollbear/tachymeter
+ */
+
+#ifndef TACHYMETER_ISOLATION_HPP
+#define TACHYMETER_ISOLATION_HPP
+
+#include "reporter.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TACHYMETER_HAS_FORK 1
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace tachymeter
+{
+
+static_assert(std::is_trivially_copyable<measurement>::value,
+              "measurements are passed between processes as raw bytes");
+
+// Serializes reporter calls into a byte stream, for a child process to send
+// its results to the parent, where replay() passes them on to the real
+// reporter. Both ends run the same binary, so measurements are sent as is.
+class stream_reporter : public reporter
+{
+public:
+  stream_reporter(std::string &buffer_, bool wants_samples_ = false)
+    : buffer(buffer_)
+    , wants(wants_samples_)
+  {
+  }
+  void report(result_sequence const &results, std::string const &name) override
+  {
+    buffer += 'R';
+    put_string(name);
+    put_integer(results.size());
+    buffer.append(reinterpret_cast<char const*>(results.data()),
+                  results.size() * sizeof(measurement));
+  }
+  void info(std::string const &key, std::string const &value) override
+  {
+    buffer += 'I';
+    put_string(key);
+    put_string(value);
+  }
+  bool wants_samples() const override { return wants; }
+  void samples(raw_samples const &s, std::string const &name) override
+  {
+    buffer += 'S';
+    put_string(name);
+    put_integer(s.data_size);
+    put_integer(s.batch_size);
+    put_values(s.durations);
+    for (auto &c : s.counters) put_values(c);
+    put_values(s.parameters);
+  }
+private:
+  void put_integer(uint64_t v)
+  {
+    buffer.append(reinterpret_cast<char const*>(&v), sizeof(v));
+  }
+  void put_string(std::string const &s)
+  {
+    put_integer(s.size());
+    buffer += s;
+  }
+  void put_values(std::vector<uint64_t> const &v)
+  {
+    put_integer(v.size());
+    buffer.append(reinterpret_cast<char const*>(v.data()),
+                  v.size() * sizeof(uint64_t));
+  }
+  std::string &buffer;
+  bool        wants;
+};
+
+// Passes the reporter calls recorded by a stream_reporter on to r. Returns
+// false if the stream ends with a truncated call, which is then ignored.
+inline bool replay(std::string const &buffer, reporter &r)
+{
+  std::size_t pos = 0;
+  auto get_integer = [&](uint64_t &v) {
+    if (buffer.size() - pos < sizeof(v)) return false;
+    std::memcpy(&v, buffer.data() + pos, sizeof(v));
+    pos += sizeof(v);
+    return true;
+  };
+  auto get_string = [&](std::string &s) {
+    uint64_t len;
+    if (!get_integer(len) || buffer.size() - pos < len) return false;
+    s.assign(buffer, pos, len);
+    pos += len;
+    return true;
+  };
+  auto get_values = [&](std::vector<uint64_t> &v) {
+    uint64_t count;
+    if (!get_integer(count)) return false;
+    if ((buffer.size() - pos) / sizeof(uint64_t) < count) return false;
+    v.resize(count);
+    std::memcpy(v.data(), buffer.data() + pos, count * sizeof(uint64_t));
+    pos += count * sizeof(uint64_t);
+    return true;
+  };
+  while (pos != buffer.size())
+  {
+    auto const type = buffer[pos++];
+    std::string name;
+    if (type == 'R')
+    {
+      uint64_t count;
+      if (!get_string(name) || !get_integer(count)) return false;
+      if ((buffer.size() - pos) / sizeof(measurement) < count) return false;
+      result_sequence results(count);
+      std::memcpy(results.data(), buffer.data() + pos,
+                  count * sizeof(measurement));
+      pos += count * sizeof(measurement);
+      r.report(results, name);
+    }
+    else if (type == 'I')
+    {
+      std::string value;
+      if (!get_string(name) || !get_string(value)) return false;
+      r.info(name, value);
+    }
+    else if (type == 'S')
+    {
+      raw_samples s;
+      if (!get_string(name) || !get_integer(s.data_size)
+          || !get_integer(s.batch_size) || !get_values(s.durations))
+      {
+        return false;
+      }
+      for (auto &c : s.counters)
+      {
+        if (!get_values(c)) return false;
+      }
+      if (!get_values(s.parameters)) return false;
+      r.samples(s, name);
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The CPUs the calling process may run on, in increasing order. Just { 0 }
+// where affinity is not supported.
+inline std::vector<int> available_cpus()
+{
+  std::vector<int> rv;
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+  {
+    for (int cpu = 0; cpu != CPU_SETSIZE; ++cpu)
+    {
+      if (CPU_ISSET(cpu, &set)) rv.push_back(cpu);
+    }
+  }
+#endif
+  if (rv.empty()) rv.push_back(0);
+  return rv;
+}
+
+// Restricts the calling thread to a set of CPUs. Returns false if not
+// possible.
+inline bool set_cpu_affinity(std::vector<int> const &cpus)
+{
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus)
+  {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    CPU_SET(cpu, &set);
+  }
+  return !cpus.empty() && sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  static_cast<void>(cpus);
+  return false;
+#endif
+}
+
+// Restricts the calling thread to one CPU. Returns false if not possible.
+inline bool pin_to_cpu(int cpu)
+{
+  return set_cpu_affinity({ cpu });
+}
+
+// Runs the calling thread with the lowest SCHED_FIFO priority, which is
+// enough to not be preempted by normally scheduled threads. Usually requires
+// CAP_SYS_NICE. Returns false if refused.
+inline bool set_fifo_scheduling()
+{
+#if defined(__linux__)
+  sched_param param{ };
+  param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+  return sched_setscheduler(0, SCHED_FIFO, &param) == 0;
+#else
+  return false;
+#endif
+}
+
+// Locks all current and future pages of the process in memory, to avoid page
+// faults during measurements. Returns false if refused, usually because of
+// RLIMIT_MEMLOCK.
+inline bool lock_memory()
+{
+#if defined(TACHYMETER_HAS_FORK)
+  return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+#else
+  return false;
+#endif
+}
+
+// Parses a CPU list like "0-3,6". Returns an empty vector if malformed, or if
+// a CPU is beyond what an affinity mask can hold.
+inline std::vector<int> parse_cpu_list(char const *s)
+{
+#if defined(__linux__)
+  long const max_cpus = CPU_SETSIZE;
+#else
+  long const max_cpus = 1024;
+#endif
+  std::vector<int> rv;
+  while (s && *s)
+  {
+    char *end;
+    auto const first = std::strtol(s, &end, 10);
+    auto last = first;
+    if (end == s || first < 0) return { };
+    if (*end == '-')
+    {
+      s = end + 1;
+      last = std::strtol(s, &end, 10);
+      if (end == s || last < first) return { };
+    }
+    if (last >= max_cpus) return { };
+    for (auto cpu = first; cpu <= last; ++cpu) rv.push_back(int(cpu));
+    if (*end != ',' && *end != '\0') return { };
+    s = *end ? end + 1 : end;
+  }
+  return rv;
+}
+
+inline std::string format_cpu_list(std::vector<int> const &cpus)
+{
+  std::string rv;
+  for (auto cpu : cpus)
+  {
+    if (!rv.empty()) rv += ',';
+    rv += std::to_string(cpu);
+  }
+  return rv;
+}
+
+}
+
+#endif //TACHYMETER_ISOLATION_HPP
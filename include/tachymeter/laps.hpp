@@ -0,0 +1,94 @@
+/*
+ * Tachymeter C++ micro benchmark
+ *
+ * Copyright Björn Fahller 2015
+ *
+ *  Use, modification and distribution is subject to the
+ *  Boost Software License, Version 1.0. (See accompanying
+ *  file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ *
+ * Project home: https://github.com/rollbear/tachymeter
+ */
+
+#ifndef TACHYMETER_LAPS_HPP
+#define TACHYMETER_LAPS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace tachymeter
+{
+
+// Times the phases of a call. A setup whose function call operator takes a
+// laps& after the size calls lap(name) at the end of each phase. A phase
+// starts at the call, or at the end of the phase before. The time after the
+// last lap() of a call is not part of any phase. Such setups are timed one
+// call at a time, whatever the batch_window.
+class laps
+{
+public:
+  // The most phases of a setup. Further phases are not timed.
+  static constexpr std::size_t max_phases = 16;
+  using now_function = int64_t (*)();
+
+  // The name is kept, not copied, so a string literal is best.
+  void lap(char const *name)
+  {
+    auto const now = clock_now();
+    ++clock_reads;
+    std::size_t i = 0;
+    while (i != num_phases
+           && phase_names[i] != name
+           && std::strcmp(phase_names[i], name) != 0)
+    {
+      ++i;
+    }
+    if (i == max_phases)
+    {
+      mark = now;
+      return;
+    }
+    if (i == num_phases) phase_names[num_phases++] = name;
+    phase_ticks[i] += static_cast<uint64_t>(now - mark);
+    ++phase_laps[i];
+    mark = now;
+  }
+
+  // Forgets all phases, before the clock tick the first starts at is known.
+  void reset(now_function f)
+  {
+    clock_now   = f;
+    num_phases  = 0;
+    clock_reads = 0;
+    for (std::size_t i = 0; i != max_phases; ++i)
+    {
+      phase_ticks[i] = 0;
+      phase_laps[i]  = 0;
+    }
+  }
+  void start(int64_t now) { mark = now; }
+  // Phases in the order they first ended.
+  std::size_t phases() const { return num_phases; }
+  char const *name(std::size_t i) const { return phase_names[i]; }
+  // The clock ticks of all ends of the phase since start().
+  uint64_t ticks(std::size_t i) const { return phase_ticks[i]; }
+  // The times the phase ended since start().
+  uint64_t count(std::size_t i) const { return phase_laps[i]; }
+  // The times lap() read the clock since start(), including the laps of
+  // phases not timed.
+  uint64_t reads() const { return clock_reads; }
+private:
+  now_function clock_now  = nullptr;
+  int64_t      mark       = 0;
+  std::size_t  num_phases = 0;
+  uint64_t     clock_reads = 0;
+  char const  *phase_names[max_phases];
+  uint64_t     phase_ticks[max_phases];
+  uint64_t     phase_laps[max_phases];
+};
+
+}
+
+#endif //TACHYMETER_LAPS_HPP
@@ -14,10 +14,38 @@
 #ifndef TACHYMETER_MEASUREMENT_HPP
 #define TACHYMETER_MEASUREMENT_HPP
 
+#include <cstddef>
 #include <cstdint>
 
 namespace tachymeter {
 
+enum class counter : std::size_t
+{
+  cycles,
+  instructions,
+  cache_references,
+  cache_misses,
+  branch_misses,
+  page_faults
+};
+
+constexpr std::size_t num_counters = 6;
+
+// The most dimensions of a multi-dimensional sequence.
+constexpr std::size_t max_parameters = 8;
+
+// The value of a counter that could not be read.
+constexpr uint64_t counter_unavailable = ~uint64_t{};
+
+inline const char* counter_name(counter c)
+{
+  static const char* const names[num_counters] = {
+    "cycles", "instructions", "cache_refs", "cache_misses", "branch_misses",
+    "page_faults"
+  };
+  return names[static_cast<std::size_t>(c)];
+}
+
 struct measurement {
   uint64_t data_size;
   uint64_t lower_quartile;
@@ -25,6 +53,63 @@ struct measurement {
   uint64_t average;
   uint64_t upper_quartile;
   uint64_t num_runs;
+  uint64_t batch_size;
+  // The median is within a few ticks of the clock resolution, so the timing
+  // is dominated by the granularity of the clock.
+  bool     near_resolution;
+  uint64_t percentile_90;
+  uint64_t percentile_99;
+  uint64_t percentile_99_9;
+  uint64_t maximum;
+  // 95% confidence interval of the median.
+  uint64_t median_low;
+  uint64_t median_high;
+  // Medians per call of the event counters, if collected.
+  bool     has_counters;
+  uint64_t counters[num_counters];
+  // Global operator new/delete calls and bytes allocated per call, if
+  // counted. NaN if the allocation hooks are not installed.
+  bool     has_allocations;
+  double   allocations_per_call;
+  double   deallocations_per_call;
+  double   bytes_per_call;
+  // Threads running the calls concurrently, and their aggregate rate. The
+  // efficiency is the rate per thread relative to the first thread count
+  // measured, normally 1. Zero for single threaded measurements.
+  uint64_t threads;
+  double   ops_per_second;
+  double   scaling_efficiency;
+  // Items and bytes one call processes, as declared by the setup, and the
+  // rates they are processed at, at the median time per call (the aggregate
+  // rate for threaded measurements). NaN if not declared.
+  bool     has_throughput;
+  double   items_per_second;
+  double   bytes_per_second;
+  // Calls made before sampling while waiting for the timings to settle, and
+  // their median time per call. Not settled means the warmup was cut short
+  // by its time limit.
+  bool     has_warmup;
+  uint64_t warmup_runs;
+  uint64_t warmup_median;
+  bool     warmup_settled;
+  // The caches were evicted between constructing the setup and the call.
+  bool     cold_cache;
+  // From a paired comparison with a baseline setup, run alternately with it
+  // on the same input: the median over the pairs of calls of the time of the
+  // baseline divided by the time of this setup, and its 95% confidence
+  // interval. Above 1 is faster than the baseline.
+  bool     has_speedup;
+  double   speedup;
+  double   speedup_low;
+  double   speedup_high;
+  // All dimensions of a multi-dimensional sequence, of which data_size is
+  // the first. No parameters for single sizes.
+  uint64_t num_parameters;
+  uint64_t parameters[max_parameters];
+  uint64_t counter_value(counter c) const
+  {
+    return counters[static_cast<std::size_t>(c)];
+  }
 };
 }
 
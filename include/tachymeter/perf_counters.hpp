@@ -0,0 +1,182 @@
+/*
+ * Tachymeter C++ micro benchmark
+ *
+ * Copyright Björn Fahller 2015
+ *
+ *  Use, modification and distribution is subject to the
+ *  Boost Software License, Version 1.0. (See accompanying
+ *  file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ *
+ * Project home: https://github.com/rollbear/tachymeter
+ */
+
+#ifndef TACHYMETER_PERF_COUNTERS_HPP
+#define TACHYMETER_PERF_COUNTERS_HPP
+
+#include "measurement.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace tachymeter
+{
+
+// Hardware and software event counters for the calling thread, read as one
+// group with Linux perf_event_open. Events the kernel refuses to open, e.g.
+// due to perf_event_paranoid or a virtual machine without a PMU, are left
+// unavailable. On other platforms all events are unavailable. When the kernel
+// multiplexes the group with other events, the counts are scaled up from the
+// time the group ran to the time it was enabled.
+class perf_counters
+{
+public:
+  using values = std::array<uint64_t, num_counters>;
+  perf_counters();
+  ~perf_counters();
+  perf_counters(perf_counters const&) = delete;
+  perf_counters& operator=(perf_counters const&) = delete;
+  bool available(counter c) const { return fds[index(c)] != -1; }
+  void start();
+  void stop();
+  // The counts since the last start(), counter_unavailable for events that
+  // could not be opened, or for all if the group never got to run.
+  values read() const;
+private:
+  static std::size_t index(counter c) { return static_cast<std::size_t>(c); }
+  std::array<int, num_counters>      fds;
+  std::array<uint64_t, num_counters> ids;
+  int                                leader = -1;
+  std::size_t                        num_open = 0;
+};
+
+#if defined(__linux__)
+
+inline
+perf_counters::perf_counters()
+{
+  static const std::pair<uint32_t, uint64_t> events[num_counters] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS }
+  };
+  fds.fill(-1);
+  for (std::size_t i = 0; i != num_counters; ++i)
+  {
+    perf_event_attr attr{ };
+    attr.size           = sizeof(attr);
+    attr.type           = events[i].first;
+    attr.config         = events[i].second;
+    attr.disabled       = leader == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_GROUP
+                          | PERF_FORMAT_ID
+                          | PERF_FORMAT_TOTAL_TIME_ENABLED
+                          | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    auto const fd = static_cast<int>(syscall(__NR_perf_event_open,
+                                             &attr, 0, -1, leader, 0));
+    if (fd == -1) continue;
+    if (ioctl(fd, PERF_EVENT_IOC_ID, &ids[i]) != 0)
+    {
+      close(fd);
+      continue;
+    }
+    fds[i] = fd;
+    if (leader == -1) leader = fd;
+    ++num_open;
+  }
+}
+
+inline
+perf_counters::~perf_counters()
+{
+  for (auto fd : fds)
+  {
+    if (fd != -1) close(fd);
+  }
+}
+
+inline
+void perf_counters::start()
+{
+  if (leader == -1) return;
+  ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+inline
+void perf_counters::stop()
+{
+  if (leader == -1) return;
+  ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+}
+
+inline
+perf_counters::values perf_counters::read() const
+{
+  values rv;
+  rv.fill(counter_unavailable);
+  if (leader == -1) return rv;
+
+  // PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED |
+  // PERF_FORMAT_TOTAL_TIME_RUNNING: nr, time_enabled, time_running, followed
+  // by nr { value, id }
+  std::array<uint64_t, 3 + 2 * num_counters> buffer;
+  auto const bytes = (3 + 2 * num_open) * sizeof(uint64_t);
+  if (::read(leader, buffer.data(), bytes) != static_cast<ssize_t>(bytes))
+  {
+    return rv;
+  }
+  auto const enabled = buffer[1];
+  auto const running = buffer[2];
+  if (running == 0) return rv;
+  auto const scale = double(enabled) / double(running);
+  for (std::size_t n = 0; n != buffer[0]; ++n)
+  {
+    auto value    = buffer[3 + 2 * n];
+    auto const id = buffer[4 + 2 * n];
+    if (running < enabled)
+    {
+      value = static_cast<uint64_t>(double(value) * scale + 0.5);
+    }
+    for (std::size_t i = 0; i != num_counters; ++i)
+    {
+      if (fds[i] != -1 && ids[i] == id) rv[i] = value;
+    }
+  }
+  return rv;
+}
+
+#else
+
+inline perf_counters::perf_counters() { fds.fill(-1); }
+inline perf_counters::~perf_counters() = default;
+inline void perf_counters::start() { }
+inline void perf_counters::stop() { }
+
+inline
+perf_counters::values perf_counters::read() const
+{
+  values rv;
+  rv.fill(counter_unavailable);
+  return rv;
+}
+
+#endif
+
+}
+
+#endif //TACHYMETER_PERF_COUNTERS_HPP
@@ -0,0 +1,236 @@
+/*
+ * Tachymeter C++ micro benchmark
+ *
+ * Copyright Björn Fahller 2015
+ *
+ *  Use, modification and distribution is subject to the
+ *  Boost Software License, Version 1.0. (See accompanying
+ *  file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ *
+ * Project home: https://github.com/rollbear/tachymeter
+ */
+
+#ifndef TACHYMETER_PROBE_HPP
+#define TACHYMETER_PROBE_HPP
+
+#include "histogram.hpp"
+#include "reporter.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tachymeter
+{
+
+// The precision of probe histograms, as for histogram.
+constexpr unsigned probe_precision_bits = 7;
+
+namespace detail
+{
+
+// The bucket counts of one thread. Only that thread writes them, so a relaxed
+// load and store is enough to count, and readers see every count eventually.
+// The padding keeps other data off the cache lines written.
+struct probe_shard
+{
+  char                  pad_before[64];
+  std::atomic<uint64_t> buckets[histogram_buckets(probe_precision_bits)];
+  char                  pad_after[64];
+};
+
+inline std::size_t next_probe_site_id()
+{
+  static std::atomic<std::size_t> next{ 0 };
+  return next++;
+}
+
+// The shards of the calling thread, indexed by site id. Ids are not reused,
+// so the shards of destroyed sites are never looked up again.
+inline std::vector<probe_shard*> &thread_probe_shards()
+{
+  thread_local std::vector<probe_shard*> shards;
+  return shards;
+}
+
+}
+
+// A named distribution of latencies, in clock ticks, recorded by probes from
+// any number of threads. Each thread records into a histogram of its own, so
+// recording never waits for other threads. The first record from a thread
+// allocates its histogram, which is kept until the site is destroyed.
+class probe_site
+{
+public:
+  explicit probe_site(std::string name_)
+    : site_name(std::move(name_))
+    , id(detail::next_probe_site_id())
+  {
+  }
+  probe_site(probe_site const &) = delete;
+  probe_site &operator=(probe_site const &) = delete;
+  void record(uint64_t ticks)
+  {
+    auto &thread_shards = detail::thread_probe_shards();
+    auto  shard = id < thread_shards.size() ? thread_shards[id] : nullptr;
+    if (!shard) shard = add_shard();
+    auto &bucket = shard->buckets[histogram_index(ticks, probe_precision_bits)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+  }
+  // Sets counts to the sum of the bucket counts of all threads so far,
+  // without stopping them.
+  void counts(std::vector<uint64_t> &counts_) const
+  {
+    counts_.assign(histogram_buckets(probe_precision_bits), 0);
+    std::lock_guard<std::mutex> lock(shards_mutex);
+    for (auto const &shard : shards)
+    {
+      for (std::size_t i = 0; i != counts_.size(); ++i)
+      {
+        counts_[i] += shard->buckets[i].load(std::memory_order_relaxed);
+      }
+    }
+  }
+  std::string const &name() const { return site_name; }
+private:
+  detail::probe_shard *add_shard()
+  {
+    std::unique_ptr<detail::probe_shard> shard(new detail::probe_shard);
+    for (auto &bucket : shard->buckets)
+    {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+    auto &thread_shards = detail::thread_probe_shards();
+    if (thread_shards.size() <= id) thread_shards.resize(id + 1);
+    thread_shards[id] = shard.get();
+    std::lock_guard<std::mutex> lock(shards_mutex);
+    shards.push_back(std::move(shard));
+    return shards.back().get();
+  }
+  std::string                                       site_name;
+  std::size_t const                                 id;
+  mutable std::mutex                                shards_mutex;
+  std::vector<std::unique_ptr<detail::probe_shard>> shards;
+};
+
+// Records the time from construction to destruction in a probe site. The
+// clock overhead is not subtracted.
+template <typename C = std::chrono::steady_clock>
+class probe
+{
+public:
+  explicit probe(probe_site &site_) : site(site_), start(C::now()) { }
+  probe(probe const &) = delete;
+  probe &operator=(probe const &) = delete;
+  ~probe()
+  {
+    auto const ticks = (C::now() - start).count();
+    site.record(ticks > 0 ? static_cast<uint64_t>(ticks) : 0U);
+  }
+private:
+  probe_site                  &site;
+  typename C::time_point const start;
+};
+
+// Reports, for each probe site watched, the statistics of the latencies
+// recorded since the collection before, as a result_sequence of one
+// measurement whose size is the number of the collection, counted from 1.
+// Sites without new latencies are not reported. The sites must outlive the
+// collector.
+class probe_collector
+{
+public:
+  explicit probe_collector(reporter &r_) : r(r_) { }
+  probe_collector(probe_collector const &) = delete;
+  probe_collector &operator=(probe_collector const &) = delete;
+  ~probe_collector() { stop(); }
+  void watch(probe_site &site)
+  {
+    std::lock_guard<std::mutex> lock(collect_mutex);
+    sites.push_back({ &site, std::vector<uint64_t>(
+                               histogram_buckets(probe_precision_bits)) });
+  }
+  void collect();
+  // Collects every interval in a thread of its own, until stop().
+  template <typename Rep, typename Period>
+  void start(std::chrono::duration<Rep, Period> interval);
+  void stop();
+private:
+  struct watched
+  {
+    probe_site            *site;
+    std::vector<uint64_t> seen;
+  };
+  reporter                &r;
+  std::vector<watched>    sites;
+  uint64_t                collections = 0;
+  std::mutex              collect_mutex;
+  std::thread             collector;
+  std::mutex              stop_mutex;
+  std::condition_variable stop_signal;
+  bool                    stopping = false;
+};
+
+inline
+void probe_collector::collect()
+{
+  std::lock_guard<std::mutex> lock(collect_mutex);
+  ++collections;
+  std::vector<uint64_t> counts;
+  histogram             samples(probe_precision_bits);
+  for (auto &w : sites)
+  {
+    w.site->counts(counts);
+    samples.clear();
+    for (std::size_t i = 0; i != counts.size(); ++i)
+    {
+      samples.add(i, counts[i] - w.seen[i]);
+    }
+    w.seen.swap(counts);
+    if (samples.count() == 0) continue;
+    measurement m = summary_of(samples);
+    m.data_size   = collections;
+    r.report({ m }, w.site->name());
+  }
+}
+
+template <typename Rep, typename Period>
+void probe_collector::start(std::chrono::duration<Rep, Period> interval)
+{
+  stop();
+  stopping  = false;
+  collector = std::thread([this, interval] {
+    std::unique_lock<std::mutex> lock(stop_mutex);
+    while (!stop_signal.wait_for(lock, interval, [this] { return stopping; }))
+    {
+      lock.unlock();
+      collect();
+      lock.lock();
+    }
+  });
+}
+
+inline
+void probe_collector::stop()
+{
+  if (!collector.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(stop_mutex);
+    stopping = true;
+  }
+  stop_signal.notify_one();
+  collector.join();
+}
+
+}
+
+#endif //TACHYMETER_PROBE_HPP
@@ -16,6 +16,7 @@
 
 #include "measurement.hpp"
 
+#include <cstdint>
 #include <vector>
 #include <string>
 
@@ -23,10 +24,31 @@ namespace tachymeter {
 
 using result_sequence = std::vector<measurement>;
 
+// The individual samples behind the measurement of one size point, as per
+// call averages of each batch, in the order they were taken.
+struct raw_samples
+{
+  uint64_t              data_size;
+  uint64_t              batch_size;
+  std::vector<uint64_t> durations;
+  // One value per sample, or empty if the counter was not collected.
+  std::vector<uint64_t> counters[num_counters];
+  // All dimensions of a multi-dimensional sequence, of which data_size is
+  // the first, as in measurement. Empty for single sizes.
+  std::vector<uint64_t> parameters;
+};
+
 class reporter {
 public:
   virtual ~reporter() {}
   virtual void report(result_sequence const& results, std::string const & name) = 0;
+  // Facts about the benchmark environment, e.g. the calibrated clock
+  // overhead, given before the results they apply to.
+  virtual void info(std::string const& /* key */, std::string const& /* value */) { }
+  // Raw samples are only kept if wanted, and are then given for each size
+  // point before report() of the job they belong to.
+  virtual bool wants_samples() const { return false; }
+  virtual void samples(raw_samples const& /* samples */, std::string const& /* name */) { }
 };
 
 }
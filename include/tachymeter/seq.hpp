@@ -5,6 +5,13 @@
 #ifndef TACHYMETER_SEQ_HPP
 #define TACHYMETER_SEQ_HPP
 
+#include "cache.hpp"
+#include "measurement.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <deque>
 #include <vector>
 namespace tachymeter
 {
@@ -169,6 +176,217 @@ seq(G &&g, T ... t)
   return seq_t<std::decay_t<G>>(std::forward<G>(g), t...);
 }
 
+// Working set sizes, in elements, around the size of each cache level:
+// 1 - 2^-k and 1 + 2^-k times the cache size for k in [0, steps], and the
+// cache size itself, rounded down to whole cache lines. The sizes are
+// increasing, without duplicates.
+class cache_seq_t : public generator
+{
+public:
+  using iterator = std::vector<std::size_t>::const_iterator;
+  cache_seq_t(std::vector<std::size_t> const &cache_bytes,
+              std::size_t                    element_size,
+              unsigned                       steps,
+              std::size_t                    line_size);
+  iterator begin() const { return sizes.begin(); }
+  iterator end() const { return sizes.end(); }
+private:
+  std::vector<std::size_t> sizes;
+};
+
+inline cache_seq_t::cache_seq_t(std::vector<std::size_t> const &cache_bytes,
+                                std::size_t                    element_size,
+                                unsigned                       steps,
+                                std::size_t                    line_size)
+{
+  auto add = [&](std::size_t bytes) {
+    bytes -= bytes % line_size;
+    if (bytes >= element_size) sizes.push_back(bytes / element_size);
+  };
+  for (auto cache : cache_bytes)
+  {
+    add(cache);
+    for (unsigned k = 0; k <= steps && k < 8 * sizeof(std::size_t); ++k)
+    {
+      add(cache - (cache >> k));
+      add(cache + (cache >> k));
+    }
+  }
+  std::sort(sizes.begin(), sizes.end());
+  sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+}
+
+// Sizes around the data caches of this machine, read from
+// /sys/devices/system/cpu, for elements of type T. Where the cache sizes
+// cannot be found, 32KiB, 1MiB and 32MiB are assumed.
+template <typename T>
+inline cache_seq_t around_caches(unsigned steps = 4)
+{
+  auto caches = data_cache_sizes();
+  if (caches.empty()) caches = { 32U << 10, 1U << 20, 32U << 20 };
+  return cache_seq_t(caches, sizeof(T), steps, cache_line_size());
+}
+
+template <typename T>
+inline cache_seq_t around_caches(std::vector<std::size_t> const &cache_bytes,
+                                 unsigned                       steps = 4,
+                                 std::size_t                    line_size = 64)
+{
+  return cache_seq_t(cache_bytes, sizeof(T), steps, line_size);
+}
+
+// A sequence of parameter combinations, each an array with one value per
+// dimension, which is passed to the setup in place of the size.
+template <std::size_t N>
+class parameter_seq_t
+{
+public:
+  using value_type = std::array<std::size_t, N>;
+  using iterator   = typename std::vector<value_type>::const_iterator;
+  explicit parameter_seq_t(std::vector<value_type> values_)
+    : values(std::move(values_)) { }
+  iterator begin() const { return values.begin(); }
+  iterator end() const { return values.end(); }
+private:
+  std::vector<value_type> values;
+};
+
+// Every combination of the values of the sequences, with the last dimension
+// varying fastest.
+template <typename ... Seqs>
+inline parameter_seq_t<sizeof...(Seqs)> product(Seqs &&... seqs)
+{
+  constexpr std::size_t N = sizeof...(Seqs);
+  std::vector<std::size_t> const dimensions[N] = {
+    std::vector<std::size_t>(std::begin(seqs), std::end(seqs))...
+  };
+  std::vector<std::array<std::size_t, N>> values;
+  if (std::any_of(std::begin(dimensions), std::end(dimensions),
+                  [](std::vector<std::size_t> const &d) { return d.empty(); }))
+  {
+    return parameter_seq_t<N>(std::move(values));
+  }
+  std::array<std::size_t, N> index{ };
+  for (;;)
+  {
+    values.emplace_back();
+    for (std::size_t d = 0; d != N; ++d)
+    {
+      values.back()[d] = dimensions[d][index[d]];
+    }
+    std::size_t d = N;
+    while (d != 0 && ++index[d - 1] == dimensions[d - 1].size())
+    {
+      index[--d] = 0;
+    }
+    if (d == 0) break;
+  }
+  return parameter_seq_t<N>(std::move(values));
+}
+
+// The values of the sequences pairwise, as long as the shortest sequence.
+template <typename ... Seqs>
+inline parameter_seq_t<sizeof...(Seqs)> zip(Seqs &&... seqs)
+{
+  constexpr std::size_t N = sizeof...(Seqs);
+  std::vector<std::size_t> const dimensions[N] = {
+    std::vector<std::size_t>(std::begin(seqs), std::end(seqs))...
+  };
+  std::size_t length = dimensions[0].size();
+  for (auto const &d : dimensions) length = std::min(length, d.size());
+  std::vector<std::array<std::size_t, N>> values(length);
+  for (std::size_t i = 0; i != length; ++i)
+  {
+    for (std::size_t d = 0; d != N; ++d) values[i][d] = dimensions[d][i];
+  }
+  return parameter_seq_t<N>(std::move(values));
+}
+
+// An adaptive sequence. It first gives the sizes of a coarse sequence, and
+// then, as long as it has given fewer than max_sizes, the geometric midpoint
+// between neighbouring sizes whose time per element differs by more than
+// threshold, unless the larger is within resolution of the smaller. The
+// benchmark passes the result of every size to result() before asking for
+// the next size with next().
+class refined_t
+{
+public:
+  template <typename Seq>
+  refined_t(Seq         &&coarse,
+            double      threshold_,
+            double      resolution_,
+            std::size_t max_sizes_)
+    : pending(std::begin(coarse), std::end(coarse))
+    , threshold(threshold_)
+    , resolution(resolution_)
+    , max_sizes(max_sizes_)
+  {
+  }
+  bool next(std::size_t &size);
+  void result(measurement const &m);
+private:
+  struct point
+  {
+    std::size_t size;
+    double      cost;
+  };
+  void refine();
+  std::deque<std::size_t> pending;
+  std::vector<point>      points;
+  double                  threshold;
+  double                  resolution;
+  std::size_t             max_sizes;
+  std::size_t             given = 0;
+};
+
+inline bool refined_t::next(std::size_t &size)
+{
+  if (pending.empty() && given < max_sizes) refine();
+  if (pending.empty() || given == max_sizes) return false;
+  size = pending.front();
+  pending.pop_front();
+  ++given;
+  return true;
+}
+
+inline void refined_t::result(measurement const &m)
+{
+  auto const size = static_cast<std::size_t>(m.data_size);
+  point const p{ size, double(m.median) / double(std::max(size, std::size_t{1})) };
+  points.insert(std::upper_bound(points.begin(), points.end(), p,
+                                 [](point const &lh, point const &rh) {
+                                   return lh.size < rh.size;
+                                 }),
+                p);
+}
+
+inline void refined_t::refine()
+{
+  for (std::size_t i = 1; i < points.size(); ++i)
+  {
+    auto const &lo = points[i - 1];
+    auto const &hi = points[i];
+    if (double(hi.size) <= double(lo.size) * (1.0 + resolution)) continue;
+    auto const low_cost  = std::min(lo.cost, hi.cost);
+    auto const high_cost = std::max(lo.cost, hi.cost);
+    if (high_cost <= low_cost * (1.0 + threshold)) continue;
+    auto const mid = static_cast<std::size_t>(
+      std::sqrt(double(std::max(lo.size, std::size_t{1})) * double(hi.size)));
+    if (mid > lo.size && mid < hi.size) pending.push_back(mid);
+  }
+}
+
+// Refines a coarse sequence of sizes where the time per element changes by
+// more than threshold (a fraction) between neighbouring sizes.
+template <typename Seq>
+inline refined_t refine(Seq         &&coarse,
+                        double      threshold = 0.2,
+                        double      resolution = 1.0 / 16,
+                        std::size_t max_sizes = 64)
+{
+  return refined_t(std::forward<Seq>(coarse), threshold, resolution, max_sizes);
+}
+
 template <typename Generator>
 class seq_t<Generator>::iterator
     : public std::iterator<std::forward_iterator_tag, std::size_t>
@@ -0,0 +1,162 @@
+/*
+ * Tachymeter C++ micro benchmark
+ *
+ * Copyright Björn Fahller 2015
+ *
+ *  Use, modification and distribution is subject to the
+ *  Boost Software License, Version 1.0. (See accompanying
+ *  file LICENSE_1_0.txt or copy at
+ *  http://www.boost.org/LICENSE_1_0.txt)
+ *
+ * Project home: https://github.com/rollbear/tachymeter
+ */
+
+#ifndef TACHYMETER_TSC_CLOCK_HPP
+#define TACHYMETER_TSC_CLOCK_HPP
+
+#if !defined(__x86_64__) && !defined(__i386__) && !defined(_M_X64) && !defined(_M_IX86)
+#error "tachymeter::tsc_clock requires an x86 processor"
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+namespace tachymeter
+{
+
+// A clock reading the processor time stamp counter, converted to nanoseconds
+// with a factor calibrated against std::chrono::steady_clock the first time
+// the clock is used. Only meaningful if the TSC is invariant, i.e. runs at a
+// constant rate regardless of frequency scaling and sleep states, which
+// is_invariant() tells. If it is not, a warning is printed to std::cerr on
+// calibration.
+class tsc_clock
+{
+public:
+  using rep        = int64_t;
+  using period     = std::nano;
+  using duration   = std::chrono::duration<rep, period>;
+  using time_point = std::chrono::time_point<tsc_clock>;
+  static constexpr bool is_steady = true;
+
+  static time_point now() noexcept
+  {
+    static calibration const &c = calibrated();
+    return time_point(duration(c.to_nanoseconds(read(c.has_rdtscp))));
+  }
+  static bool is_invariant();
+  static bool has_rdtscp();
+  // The calibrated number of TSC ticks per second.
+  static double ticks_per_second() { return calibrated().ticks_per_second; }
+private:
+  struct calibration
+  {
+    double   ticks_per_second;
+    uint64_t multiplier; // nanoseconds per tick, as 32.32 fixed point
+    bool     has_rdtscp;
+    int64_t to_nanoseconds(uint64_t ticks) const
+    {
+#if defined(__SIZEOF_INT128__)
+      __extension__ typedef unsigned __int128 wide;
+      return int64_t(wide(ticks) * multiplier >> 32);
+#else
+      return int64_t((ticks >> 32) * multiplier
+                     + ((ticks & 0xffffffffU) * multiplier >> 32));
+#endif
+    }
+  };
+  static uint64_t read(bool rdtscp) noexcept;
+  static void cpuid(uint32_t leaf, uint32_t regs[4]);
+  static calibration const &calibrated();
+};
+
+inline
+void tsc_clock::cpuid(uint32_t leaf, uint32_t regs[4])
+{
+#if defined(_MSC_VER)
+  __cpuid(reinterpret_cast<int*>(regs), int(leaf));
+#else
+  regs[0] = regs[1] = regs[2] = regs[3] = 0;
+  __get_cpuid(leaf, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+}
+
+inline
+bool tsc_clock::is_invariant()
+{
+  uint32_t regs[4];
+  cpuid(0x80000000U, regs);
+  if (regs[0] < 0x80000007U) return false;
+  cpuid(0x80000007U, regs);
+  return (regs[3] & (1U << 8)) != 0;
+}
+
+inline
+bool tsc_clock::has_rdtscp()
+{
+  uint32_t regs[4];
+  cpuid(0x80000000U, regs);
+  if (regs[0] < 0x80000001U) return false;
+  cpuid(0x80000001U, regs);
+  return (regs[3] & (1U << 27)) != 0;
+}
+
+inline
+uint64_t tsc_clock::read(bool rdtscp) noexcept
+{
+  // rdtscp waits for all earlier instructions to finish, rdtsc needs a
+  // leading lfence for that. The trailing lfence keeps later instructions
+  // from starting before the counter is read.
+  uint64_t ticks;
+  if (rdtscp)
+  {
+    unsigned aux;
+    ticks = __rdtscp(&aux);
+  }
+  else
+  {
+    _mm_lfence();
+    ticks = __rdtsc();
+  }
+  _mm_lfence();
+  return ticks;
+}
+
+inline
+tsc_clock::calibration const &tsc_clock::calibrated()
+{
+  static calibration const c = [] {
+    using namespace std::chrono;
+    constexpr auto interval = milliseconds(20);
+
+    if (!is_invariant())
+    {
+      std::cerr << "tachymeter::tsc_clock: the TSC is not invariant, "
+                   "measurements may be affected by frequency changes\n";
+    }
+    bool const rdtscp = has_rdtscp();
+    auto const start = steady_clock::now();
+    auto const start_ticks = read(rdtscp);
+    auto end = start;
+    while (end - start < interval) end = steady_clock::now();
+    auto const end_ticks = read(rdtscp);
+
+    auto const seconds = std::chrono::duration<double>(end - start).count();
+    auto const tps = double(end_ticks - start_ticks) / seconds;
+    auto const mul = uint64_t(1e9 / tps * 4294967296.0);
+    return calibration{ tps, mul, rdtscp };
+  }();
+  return c;
+}
+
+}
+
+#endif //TACHYMETER_TSC_CLOCK_HPP
@@ -14,6 +14,16 @@
 #include <tachymeter/benchmark.hpp>
 #include <tachymeter/CSV_reporter.hpp>
 #include <tachymeter/seq.hpp>
+#include <tachymeter/histogram.hpp>
+#include <tachymeter/baseline.hpp>
+#include <tachymeter/binary_reporter.hpp>
+#include <tachymeter/cache.hpp>
+#include <tachymeter/probe.hpp>
+#if defined(__x86_64__) || defined(__i386__)
+#include <tachymeter/tsc_clock.hpp>
+#endif
+#define TACHYMETER_ALLOCATION_HOOKS
+#include <tachymeter/allocations.hpp>
 #include <trompeloeil.hpp>
 
 #define CATCH_CONFIG_MAIN
@@ -36,12 +46,34 @@ private:
 
 test_clock* test_clock::instance;
 
+class atomic_test_clock
+{
+public:
+  using duration = std::chrono::milliseconds;
+  using time_point = std::chrono::milliseconds;
+  static time_point now() { return time_point(ticks++); }
+  static std::atomic<int> ticks;
+};
+
+std::atomic<int> atomic_test_clock::ticks{ 0 };
+
 class mock_reporter : public tachymeter::reporter
 {
 public:
   MAKE_MOCK2(report, void(tachymeter::result_sequence const& results, std::string const & name));
 };
 
+class info_reporter : public tachymeter::reporter
+{
+public:
+  void report(tachymeter::result_sequence const&, std::string const&) override { }
+  void info(std::string const& key, std::string const& value) override
+  {
+    infos.emplace_back(key, value);
+  }
+  std::vector<std::pair<std::string, std::string>> infos;
+};
+
 class test_mock
 {
 public:
@@ -59,6 +91,157 @@ public:
   void operator()(std::size_t size) { mock_tests[idx]->call(size);}
 };
 
+class allocating_test
+{
+public:
+  allocating_test(std::size_t) { }
+  void operator()(std::size_t size)
+  {
+    std::unique_ptr<char[]> p(new char[size]);
+    sink = p.get();
+  }
+  static char* volatile sink;
+};
+
+char* volatile allocating_test::sink;
+
+class concurrent_test
+{
+public:
+  concurrent_test(std::size_t) { ++constructions; }
+  void operator()(std::size_t) { ++calls; }
+  static std::atomic<int> constructions;
+  static std::atomic<int> calls;
+};
+
+std::atomic<int> concurrent_test::constructions;
+std::atomic<int> concurrent_test::calls;
+
+class parsing_test
+{
+public:
+  parsing_test(std::size_t) { }
+  void operator()(std::size_t) { ticks += 4; }
+  static std::size_t items_processed(std::size_t size) { return size; }
+  static std::size_t bytes_processed(std::size_t size) { return size * 8; }
+  static int ticks;
+};
+
+int parsing_test::ticks;
+
+class sweep_test
+{
+public:
+  using parameters = std::array<std::size_t, 2>;
+  sweep_test(parameters const &p) { constructed.push_back(p); }
+  void operator()(parameters const &) { }
+  static std::vector<parameters> constructed;
+};
+
+std::vector<sweep_test::parameters> sweep_test::constructed;
+
+class reset_test
+{
+public:
+  reset_test(std::size_t) { ++constructions; }
+  void reset(std::size_t) { ++resets; }
+  void operator()(std::size_t) { ++calls; }
+  static int constructions;
+  static int resets;
+  static int calls;
+};
+
+int reset_test::constructions;
+int reset_test::resets;
+int reset_test::calls;
+
+class prototype_test
+{
+public:
+  static constexpr bool copy_prototype = true;
+  prototype_test(std::size_t) { ++constructions; }
+  prototype_test(prototype_test const &) { ++copies; }
+  void operator()(std::size_t) { ++calls; }
+  static int constructions;
+  static int copies;
+  static int calls;
+};
+
+int prototype_test::constructions;
+int prototype_test::copies;
+int prototype_test::calls;
+
+class lap_test
+{
+public:
+  lap_test(std::size_t) { }
+  void operator()(std::size_t, tachymeter::laps &l)
+  {
+    ticks += 2;
+    l.lap("first");
+    ticks += 6;
+    l.lap("second");
+  }
+  static int ticks;
+};
+
+int lap_test::ticks;
+
+int compare_ticks;
+
+template <int cost>
+class compare_test
+{
+public:
+  compare_test(std::size_t, tachymeter::seed_type seed) { seeds.push_back(seed); }
+  void operator()(std::size_t) { compare_ticks += cost; }
+  static std::vector<tachymeter::seed_type> seeds;
+};
+
+template <int cost>
+std::vector<tachymeter::seed_type> compare_test<cost>::seeds;
+
+class noisy_compare_test
+{
+public:
+  noisy_compare_test(std::size_t) { }
+  void operator()(std::size_t) { compare_ticks += (++calls % 3) ? 1 : 10; }
+  static int calls;
+};
+
+int noisy_compare_test::calls;
+
+template <typename T>
+class typed_test
+{
+public:
+  typed_test(std::size_t size) { element_bytes.push_back(size * sizeof(T)); }
+  void operator()(std::size_t) { }
+  static std::vector<std::size_t> element_bytes;
+};
+
+template <typename T>
+std::vector<std::size_t> typed_test<T>::element_bytes;
+
+tachymeter::measurement sample_measurement()
+{
+  tachymeter::measurement m{ };
+  m.data_size       = 10;
+  m.lower_quartile  = 1;
+  m.median          = 2;
+  m.average         = 2;
+  m.upper_quartile  = 3;
+  m.num_runs        = 9;
+  m.batch_size      = 1;
+  m.percentile_90   = 4;
+  m.percentile_99   = 5;
+  m.percentile_99_9 = 5;
+  m.maximum         = 5;
+  m.median_low      = 1;
+  m.median_high     = 3;
+  return m;
+}
+
 TEST_CASE("seq object repeats given numbers in range for loop", "[sequences]")
 {
   auto s = tachymeter::seq(1, 5, 3, 1, 8, 33);
@@ -354,7 +537,1567 @@ TEST_CASE("benchmark::run with unknown flag gives usage", "[benchmark]")
       const_cast<char*>("-w")
   };
   std::ostringstream os;
-  b.run(2, argv, os);
+  REQUIRE(b.run(2, argv, os) == 1);
+
+  REQUIRE(os.str() == "Usage: apa [-j <processes>] [-c <cpus>] [-f] [-m]"
+                      " [-i <rounds>] [-b <baseline dir> [-t <percent>]] [-a]"
+                      " {-l | <names>}\n");
+}
+TEST_CASE("benchmark::run with batch window times calls in calibrated batches and reports per call times", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<dummy_test<0>>(tachymeter::seq(123), "apa", { 1ms, 4ms });
+  test_mock m;
+  mock_tests[0] = &m;
+  // each call takes 1ms, and the clock ticks 1ms per read, so calibration
+  // runs batches of 1, 2 and 4, then 9 batches of 4 are timed
+  REQUIRE_CALL(m, constr(123U))
+  .TIMES(43);
+  REQUIRE_CALL(m, call(123U))
+  .TIMES(43)
+  .LR_SIDE_EFFECT(++tick);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(os.str() == "");
+  REQUIRE(results.size() == 1U);
+  REQUIRE(results[0].batch_size == 4U);
+  REQUIRE(results[0].num_runs == 36U);
+  REQUIRE(results[0].median == 1U);
+}
+
+TEST_CASE("benchmark::run subtracts the calibrated clock overhead and reports it", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<dummy_test<0>>(tachymeter::seq(123), "apa", 1ms);
+  test_mock m;
+  mock_tests[0] = &m;
+  REQUIRE_CALL(m, constr(123U))
+  .TIMES(9);
+  REQUIRE_CALL(m, call(123U))
+  .TIMES(9)
+  .LR_SIDE_EFFECT(tick += 2);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(os.str() == "");
+  REQUIRE(results.size() == 1U);
+  REQUIRE(results[0].median == 2U);
+  REQUIRE(results[0].near_resolution);
+}
+
+TEST_CASE("CSV_reporter writes info lines before the column header", "[reporter]")
+{
+  std::ostringstream os;
+  tachymeter::CSV_reporter reporter(nullptr, &os);
+  reporter.info("clock overhead", "3");
+  auto const m = sample_measurement();
+  reporter.report({ m }, "apa");
+  REQUIRE(os.str() == "# clock overhead: 3\n"
+                      "# apa\n"
+                      "#size,lo_q,median,agerage,hi_q,runs,batch,p90,p99,p99.9,max,median_lo,median_hi\n"
+                      "10,1,2,2,3,9,1,4,5,5,5,1,3\n");
+}
+
+TEST_CASE("histogram records small values exactly", "[histogram]")
+{
+  tachymeter::histogram h;
+  for (uint64_t v : { 5, 1, 100, 3, 3 }) h.record(v);
+  REQUIRE(h.count() == 5U);
+  REQUIRE(h.min() == 1U);
+  REQUIRE(h.max() == 100U);
+  REQUIRE(h.at_rank(0) == 1U);
+  REQUIRE(h.at_rank(1) == 3U);
+  REQUIRE(h.at_rank(2) == 3U);
+  REQUIRE(h.at_rank(3) == 5U);
+  REQUIRE(h.at_rank(4) == 100U);
+  REQUIRE(h.mean(1, 4) == 3U);
+}
+
+TEST_CASE("histogram ranks large values within its relative precision", "[histogram]")
+{
+  tachymeter::histogram h;
+  for (uint64_t v = 1; v <= 100000; ++v) h.record(v * 1000);
+  REQUIRE(h.count() == 100000U);
+  REQUIRE(h.max() == 100000000U);
+  auto const within = [](uint64_t actual, uint64_t expected) {
+    return actual >= expected - expected / 64 && actual <= expected + expected / 64;
+  };
+  REQUIRE(within(h.at_rank(49999), 50000000U));
+  REQUIRE(within(h.at_rank(98999), 99000000U));
+  REQUIRE(within(h.mean(25000, 75000), 50000500U));
+}
+
+TEST_CASE("benchmark::run reports tail percentiles and maximum", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<dummy_test<0>>(tachymeter::seq(123), "apa", 1ms);
+  test_mock m;
+  mock_tests[0] = &m;
+  int calls = 0;
+  REQUIRE_CALL(m, constr(123U))
+  .TIMES(9);
+  REQUIRE_CALL(m, call(123U))
+  .TIMES(9)
+  .LR_SIDE_EFFECT(tick += ++calls);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(results.size() == 1U);
+  REQUIRE(results[0].lower_quartile == 3U);
+  REQUIRE(results[0].median == 5U);
+  REQUIRE(results[0].upper_quartile == 7U);
+  REQUIRE(results[0].percentile_90 == 9U);
+  REQUIRE(results[0].maximum == 9U);
+}
+
+TEST_CASE("benchmark::run with precision target stops when the median confidence interval is narrow enough", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  tachymeter::benchmark<test_clock>::options opts{ 1ms };
+  opts.precision = 0.01;
+  opts.max_runs = 101;
+  b.measure<dummy_test<0>>(tachymeter::seq(123), "apa", opts);
+  test_mock m;
+  mock_tests[0] = &m;
+  REQUIRE_CALL(m, constr(123U))
+  .TIMES(9);
+  REQUIRE_CALL(m, call(123U))
+  .TIMES(9)
+  .LR_SIDE_EFFECT(tick += 2);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(results.size() == 1U);
+  REQUIRE(results[0].median_low == 2U);
+  REQUIRE(results[0].median_high == 2U);
+}
+
+TEST_CASE("benchmark::run with precision target samples noisy timings until max runs", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  tachymeter::benchmark<test_clock>::options opts{ 1ms };
+  opts.precision = 0.01;
+  opts.max_time = 10s;
+  opts.max_runs = 21;
+  b.measure<dummy_test<0>>(tachymeter::seq(123), "apa", opts);
+  test_mock m;
+  mock_tests[0] = &m;
+  int calls = 0;
+  REQUIRE_CALL(m, constr(123U))
+  .TIMES(21);
+  REQUIRE_CALL(m, call(123U))
+  .TIMES(21)
+  .LR_SIDE_EFFECT(tick += (++calls & 1) ? 1 : 10);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(results.size() == 1U);
+  REQUIRE(results[0].num_runs == 21U);
+  REQUIRE(results[0].median_low < results[0].median_high);
+}
+
+TEST_CASE("benchmark::run with precision target and a zero median stops at 100 times min_time", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  tachymeter::benchmark<test_clock>::options opts{ 1ms };
+  opts.precision = 0.01;
+  b.measure<dummy_test<0>>(tachymeter::seq(123), "apa", opts);
+  test_mock m;
+  mock_tests[0] = &m;
+  REQUIRE_CALL(m, constr(123U))
+  .TIMES(101);
+  REQUIRE_CALL(m, call(123U))
+  .TIMES(101);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(results.size() == 1U);
+  REQUIRE(results[0].median == 0U);
+  REQUIRE(results[0].num_runs == 101U);
+}
+
+TEST_CASE("CSV_reporter writes counter columns when counters are collected, n/a when unavailable", "[reporter]")
+{
+  std::ostringstream os;
+  tachymeter::CSV_reporter reporter(nullptr, &os);
+  auto const na = tachymeter::counter_unavailable;
+  auto m = sample_measurement();
+  m.has_counters = true;
+  uint64_t const counters[] = { 100, 200, na, na, 7, 0 };
+  std::copy(std::begin(counters), std::end(counters), m.counters);
+  reporter.report({ m }, "apa");
+  REQUIRE(os.str() == "# apa\n"
+                      "#size,lo_q,median,agerage,hi_q,runs,batch,p90,p99,p99.9,max,median_lo,median_hi,"
+                      "cycles,instructions,cache_refs,cache_misses,branch_misses,page_faults\n"
+                      "10,1,2,2,3,9,1,4,5,5,5,1,3,100,200,n/a,n/a,7,0\n");
+}
+
+TEST_CASE("benchmark::run with counters reports counters, or marks them unavailable", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  tachymeter::benchmark<test_clock>::options opts{ 1ms };
+  opts.counters = true;
+  b.measure<dummy_test<0>>(tachymeter::seq(123), "apa", opts);
+  test_mock m;
+  mock_tests[0] = &m;
+  REQUIRE_CALL(m, constr(123U))
+  .TIMES(9);
+  REQUIRE_CALL(m, call(123U))
+  .TIMES(9);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(results.size() == 1U);
+  REQUIRE(results[0].has_counters);
+  tachymeter::perf_counters pmu;
+  for (std::size_t i = 0; i != tachymeter::num_counters; ++i)
+  {
+    auto const c = static_cast<tachymeter::counter>(i);
+    REQUIRE((results[0].counter_value(c) != tachymeter::counter_unavailable) == pmu.available(c));
+  }
+}
+
+TEST_CASE("benchmark::run with allocations counts the allocations made by the timed calls", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  tachymeter::benchmark<test_clock>::options opts{ 1ms };
+  opts.allocations = true;
+  b.measure<allocating_test>(tachymeter::seq(123), "apa", opts);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(results.size() == 1U);
+  REQUIRE(results[0].has_allocations);
+  REQUIRE(results[0].allocations_per_call == 1.0);
+  REQUIRE(results[0].deallocations_per_call == 1.0);
+  REQUIRE(results[0].bytes_per_call == 123.0);
+}
+
+TEST_CASE("CSV_reporter writes allocation columns when allocations are counted", "[reporter]")
+{
+  std::ostringstream os;
+  tachymeter::CSV_reporter reporter(nullptr, &os);
+  auto m = sample_measurement();
+  m.has_allocations = true;
+  m.allocations_per_call = 0.5;
+  m.deallocations_per_call = 0;
+  m.bytes_per_call = 16;
+  reporter.report({ m }, "apa");
+  REQUIRE(os.str() == "# apa\n"
+                      "#size,lo_q,median,agerage,hi_q,runs,batch,p90,p99,p99.9,max,median_lo,median_hi,"
+                      "allocs,deallocs,bytes\n"
+                      "10,1,2,2,3,9,1,4,5,5,5,1,3,0.5,0,16\n");
+}
+
+TEST_CASE("benchmark::run reports items and bytes per second for setups declaring them", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  tachymeter::result_sequence plain;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  REQUIRE_CALL(reporter, report(_, "katt"))
+  .LR_SIDE_EFFECT(plain = _1);
+  test_clock clock;
+  int &tick = parsing_test::ticks;
+  tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<parsing_test>(tachymeter::seq(1000), "apa", 10ms);
+  b.measure<dummy_test<0>>(tachymeter::seq(3), "katt", 10ms);
+  test_mock m;
+  mock_tests[0] = &m;
+  ALLOW_CALL(m, constr(_));
+  ALLOW_CALL(m, call(_));
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(results.size() == 1U);
+  REQUIRE(results[0].has_throughput);
+  REQUIRE(results[0].median != 0U);
+  auto const seconds = double(results[0].median) / 1000;
+  REQUIRE(results[0].items_per_second == Approx(1000 / seconds));
+  REQUIRE(results[0].bytes_per_second == Approx(8000 / seconds));
+  REQUIRE(plain.size() == 1U);
+  REQUIRE(!plain[0].has_throughput);
+}
+
+TEST_CASE("CSV_reporter writes throughput columns when setups declare them", "[reporter]")
+{
+  std::ostringstream os;
+  tachymeter::CSV_reporter reporter(nullptr, &os);
+  auto m = sample_measurement();
+  m.has_throughput = true;
+  m.items_per_second = 500;
+  m.bytes_per_second = std::numeric_limits<double>::quiet_NaN();
+  reporter.report({ m }, "apa");
+  REQUIRE(os.str() == "# apa\n"
+                      "#size,lo_q,median,agerage,hi_q,runs,batch,p90,p99,p99.9,max,median_lo,median_hi,"
+                      "items/s,bytes/s,GB/s\n"
+                      "10,1,2,2,3,9,1,4,5,5,5,1,3,500,n/a,n/a\n");
+}
 
-  REQUIRE(os.str() == "Usage: apa {-l | <names>}\n");
-}
\ No newline at end of file
+TEST_CASE("benchmark::run with max warmup runs each size until the timings settle before sampling", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  using bench = tachymeter::benchmark<test_clock>;
+  bench b(reporter);
+  bench::options opts{ 10ms };
+  opts.max_warmup = 10s;
+  b.measure<dummy_test<0>>(tachymeter::seq(10), "apa", opts);
+  test_mock m;
+  mock_tests[0] = &m;
+  int calls = 0;
+  ALLOW_CALL(m, constr(_));
+  ALLOW_CALL(m, call(_))
+  .LR_SIDE_EFFECT(tick += std::max(4, 60 - calls++));
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(results.size() == 1U);
+  REQUIRE(results[0].has_warmup);
+  REQUIRE(results[0].warmup_settled);
+  REQUIRE(results[0].warmup_runs >= 56U);
+  REQUIRE(results[0].warmup_median > 4U);
+  REQUIRE(results[0].maximum == 4U);
+}
+
+TEST_CASE("CSV_reporter writes warmup columns, and warns when timings did not settle", "[reporter]")
+{
+  std::ostringstream os;
+  tachymeter::CSV_reporter reporter(nullptr, &os);
+  auto m = sample_measurement();
+  m.has_warmup = true;
+  m.warmup_runs = 32;
+  m.warmup_median = 7;
+  m.warmup_settled = false;
+  reporter.report({ m }, "apa");
+  REQUIRE(os.str() == "# apa\n"
+                      "#size,lo_q,median,agerage,hi_q,runs,batch,p90,p99,p99.9,max,median_lo,median_hi,"
+                      "warmup,warmup_median\n"
+                      "10,1,2,2,3,9,1,4,5,5,5,1,3,32,7\n"
+                      "# warning: timings at size 10 did not settle during warmup\n");
+}
+
+TEST_CASE("cache_evictor sweeps a buffer larger than the last level cache", "[cache]")
+{
+  auto const sizes = tachymeter::data_cache_sizes();
+  REQUIRE(std::is_sorted(sizes.begin(), sizes.end()));
+  tachymeter::cache_evictor evictor;
+  REQUIRE(evictor.size() >= 2 * (sizes.empty() ? 1U : sizes.back()));
+  evictor.evict();
+}
+
+TEST_CASE("benchmark::run with cold cache evicts the caches and labels the results cold", "[benchmark]")
+{
+  std::ostringstream out;
+  tachymeter::CSV_reporter reporter(nullptr, &out);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  using bench = tachymeter::benchmark<test_clock>;
+  bench b(reporter);
+  bench::options opts{ 1ms };
+  opts.cold_cache = true;
+  b.measure<dummy_test<0>>(tachymeter::seq(10), "apa", opts);
+  b.measure<dummy_test<0>>(tachymeter::seq(10), "katt", 1ms);
+  test_mock m;
+  mock_tests[0] = &m;
+  ALLOW_CALL(m, constr(_));
+  ALLOW_CALL(m, call(_));
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(out.str().find("# apa (cold cache)\n") != std::string::npos);
+  REQUIRE(out.str().find("# katt\n") != std::string::npos);
+}
+
+TEST_CASE("benchmark::run with cold cache and batch window evicts the caches before every call", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  using bench = tachymeter::benchmark<test_clock>;
+  bench b(reporter);
+  bench::options opts{ 1ms, 10ms };
+  opts.cold_cache = true;
+  b.measure<dummy_test<0>>(tachymeter::seq(10), "apa", opts);
+  test_mock m;
+  mock_tests[0] = &m;
+  std::vector<int> call_ticks;
+  ALLOW_CALL(m, constr(_));
+  ALLOW_CALL(m, call(_))
+  .LR_SIDE_EFFECT(call_ticks.push_back(tick));
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(results[0].batch_size == 1U);
+  REQUIRE(call_ticks.size() == results[0].num_runs);
+  // The clock is read after a call, before and after the eviction, and
+  // before the next call.
+  for (std::size_t i = 1; i != call_ticks.size(); ++i)
+  {
+    REQUIRE(call_ticks[i] - call_ticks[i - 1] >= 4);
+  }
+}
+
+TEST_CASE("benchmark::measure_threaded runs each thread count concurrently on one shared setup per size", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  tachymeter::benchmark<atomic_test_clock> b(reporter);
+  b.measure_threaded<concurrent_test>(tachymeter::seq(10, 20),
+                                      tachymeter::seq(1, 4),
+                                      "apa",
+                                      1ms);
+  concurrent_test::constructions = 0;
+  concurrent_test::calls = 0;
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(concurrent_test::constructions == 4);
+  REQUIRE(results.size() == 4U);
+  REQUIRE(results[0].data_size == 10U);
+  REQUIRE(results[0].threads == 1U);
+  REQUIRE(results[0].num_runs == 9U);
+  REQUIRE(results[0].scaling_efficiency == 1.0);
+  REQUIRE(results[1].data_size == 10U);
+  REQUIRE(results[1].threads == 4U);
+  REQUIRE(results[1].num_runs == 36U);
+  REQUIRE(results[1].ops_per_second > 0.0);
+  REQUIRE(results[3].data_size == 20U);
+  REQUIRE(results[3].threads == 4U);
+  REQUIRE(concurrent_test::calls == 90);
+}
+
+TEST_CASE("benchmark::measure_threaded runs more threads than CPUs in the affinity set", "[benchmark]")
+{
+  auto const original = tachymeter::available_cpus();
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  tachymeter::benchmark<atomic_test_clock> b(reporter);
+  b.cpus({ original.back() });
+  b.measure_threaded<concurrent_test>(tachymeter::seq(10),
+                                      tachymeter::seq(8),
+                                      "apa",
+                                      1ms);
+  concurrent_test::calls = 0;
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  tachymeter::set_cpu_affinity(original);
+  REQUIRE(results.size() == 1U);
+  REQUIRE(results[0].threads == 8U);
+  REQUIRE(results[0].num_runs == 72U);
+  REQUIRE(concurrent_test::calls == 72);
+}
+
+TEST_CASE("benchmark::run with -j flag runs the jobs in child processes and reports them in order", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::benchmark<atomic_test_clock> b(reporter);
+
+  b.measure<concurrent_test>(tachymeter::seq(10, 20), "first", 1ms);
+  b.measure<concurrent_test>(tachymeter::seq(30), "second", 1ms);
+  b.measure<concurrent_test>(tachymeter::seq(40), "third", 1ms);
+
+  std::vector<tachymeter::result_sequence> results;
+  trompeloeil::sequence report_seq;
+  REQUIRE_CALL(reporter, report(_, "first"))
+  .LR_SIDE_EFFECT(results.push_back(_1))
+  .IN_SEQUENCE(report_seq);
+  REQUIRE_CALL(reporter, report(_, "third"))
+  .LR_SIDE_EFFECT(results.push_back(_1))
+  .IN_SEQUENCE(report_seq);
+
+  concurrent_test::calls = 0;
+  char *argv[] = {
+      const_cast<char *>("apa"),
+      const_cast<char *>("-j2"),
+      const_cast<char*>("third"),
+      const_cast<char*>("first")
+  };
+  std::ostringstream os;
+  b.run(4, argv, os);
+  REQUIRE(os.str() == "");
+  REQUIRE(concurrent_test::calls == 0);
+  REQUIRE(results.size() == 2U);
+  REQUIRE(results[0].size() == 2U);
+  REQUIRE(results[0][0].data_size == 10U);
+  REQUIRE(results[0][0].num_runs == 9U);
+  REQUIRE(results[0][1].data_size == 20U);
+  REQUIRE(results[1].size() == 1U);
+  REQUIRE(results[1][0].data_size == 40U);
+}
+
+TEST_CASE("benchmark::run with -i flag interleaves rounds of all jobs and reports them in order", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence apa_results;
+  tachymeter::result_sequence katt_results;
+  trompeloeil::sequence seq;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .IN_SEQUENCE(seq)
+  .LR_SIDE_EFFECT(apa_results = _1);
+  REQUIRE_CALL(reporter, report(_, "katt"))
+  .IN_SEQUENCE(seq)
+  .LR_SIDE_EFFECT(katt_results = _1);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<dummy_test<0>>(tachymeter::seq(1, 2), "apa", 40ms);
+  b.measure<dummy_test<1>>(tachymeter::seq(3), "katt", 40ms);
+  test_mock m1;
+  test_mock m2;
+  mock_tests[0] = &m1;
+  mock_tests[1] = &m2;
+  std::string order;
+  auto const ran = [&](char c) {
+    if (order.empty() || order.back() != c) order += c;
+  };
+  ALLOW_CALL(m1, constr(_));
+  ALLOW_CALL(m1, call(_))
+  .LR_SIDE_EFFECT(tick += int(_1); ran('a'));
+  ALLOW_CALL(m2, constr(_));
+  ALLOW_CALL(m2, call(_))
+  .LR_SIDE_EFFECT(tick += int(_1); ran('k'));
+
+  char *argv[] = { const_cast<char*>("apa"), const_cast<char*>("-i4") };
+  std::ostringstream os;
+  REQUIRE(b.run(2, argv, os) == 0);
+  REQUIRE(order.size() > 3U);
+  REQUIRE(apa_results.size() == 2U);
+  REQUIRE(apa_results[0].data_size == 1U);
+  REQUIRE(apa_results[0].median == 1U);
+  REQUIRE(apa_results[1].data_size == 2U);
+  REQUIRE(apa_results[1].median == 2U);
+  REQUIRE(katt_results.size() == 1U);
+  REQUIRE(katt_results[0].median == 3U);
+  REQUIRE(katt_results[0].num_runs >= 9U);
+}
+
+TEST_CASE("parse_cpu_list accepts comma separated CPUs and ranges", "[isolation]")
+{
+  REQUIRE(tachymeter::parse_cpu_list("0-3,6") == (std::vector<int>{ 0, 1, 2, 3, 6 }));
+  REQUIRE(tachymeter::parse_cpu_list("2") == (std::vector<int>{ 2 }));
+  REQUIRE(tachymeter::parse_cpu_list("3-1").empty());
+  REQUIRE(tachymeter::parse_cpu_list("1,x").empty());
+  REQUIRE(tachymeter::parse_cpu_list("").empty());
+}
+
+TEST_CASE("parse_cpu_list rejects CPUs beyond an affinity mask", "[isolation]")
+{
+  REQUIRE(tachymeter::parse_cpu_list("0-2000000000").empty());
+  REQUIRE(tachymeter::parse_cpu_list("1,99999999999").empty());
+}
+
+TEST_CASE("benchmark::run with -c flag pins the measuring thread and reports it", "[benchmark]")
+{
+  auto const original = tachymeter::available_cpus();
+  info_reporter reporter;
+  tachymeter::benchmark<atomic_test_clock> b(reporter);
+  b.measure<concurrent_test>(tachymeter::seq(10), "first", 1ms);
+
+  auto const cpu = std::to_string(original.back());
+  char *argv[] = {
+      const_cast<char *>("apa"),
+      const_cast<char *>("-c"),
+      const_cast<char *>(cpu.c_str())
+  };
+  std::ostringstream os;
+  b.run(3, argv, os);
+  auto const pinned = tachymeter::available_cpus();
+  tachymeter::set_cpu_affinity(original);
+
+  REQUIRE(os.str() == "");
+  REQUIRE(pinned == std::vector<int>{ original.back() });
+  REQUIRE(std::find(reporter.infos.begin(), reporter.infos.end(),
+                    std::make_pair(std::string("cpus"), cpu)) != reporter.infos.end());
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+TEST_CASE("tsc_clock measures time in nanoseconds consistent with steady_clock", "[clock]")
+{
+  using tachymeter::tsc_clock;
+  REQUIRE(tsc_clock::ticks_per_second() > 0.0);
+  auto const steady_start = std::chrono::steady_clock::now();
+  auto const tsc_start = tsc_clock::now();
+  auto steady_end = steady_start;
+  while (steady_end - steady_start < 10ms) steady_end = std::chrono::steady_clock::now();
+  auto const tsc_end = tsc_clock::now();
+  auto const tsc_ns = (tsc_end - tsc_start).count();
+  auto const steady_ns = std::chrono::nanoseconds(steady_end - steady_start).count();
+  REQUIRE(tsc_ns > steady_ns * 9 / 10);
+  REQUIRE(tsc_ns < steady_ns * 11 / 10);
+}
+#endif
+
+TEST_CASE("baseline_reporter compares medians with a baseline written by CSV_reporter", "[baseline]")
+{
+  char dir[] = "/tmp/tachymeter_baselineXXXXXX";
+  REQUIRE(mkdtemp(dir) != nullptr);
+  auto base = sample_measurement();
+  base.median      = 100;
+  base.median_low  = 98;
+  base.median_high = 102;
+  auto small = base;
+  small.data_size = 20;
+  {
+    tachymeter::CSV_reporter csv(dir);
+    csv.report({ base, small }, "apa");
+  }
+  tachymeter::result_sequence old;
+  REQUIRE(tachymeter::read_CSV_results(std::string(dir) + "/apa", old));
+  REQUIRE(old.size() == 2U);
+  REQUIRE(old[0].data_size == 10U);
+  REQUIRE(old[0].median == 100U);
+  REQUIRE(old[0].median_low == 98U);
+  REQUIRE(old[0].median_high == 102U);
+
+  mock_reporter next;
+  REQUIRE_CALL(next, report(_, "apa"));
+  REQUIRE_CALL(next, report(_, "katt"));
+  std::ostringstream os;
+  tachymeter::baseline_reporter r(dir, 0.05, next, os);
+
+  auto slower = base;
+  slower.median      = 110;
+  slower.median_low  = 108;
+  slower.median_high = 112;
+  auto same = small;
+  same.median      = 101;
+  same.median_low  = 99;
+  same.median_high = 103;
+  r.report({ slower, same }, "apa");
+  r.report({ slower }, "katt");
+
+  REQUIRE(os.str() == "apa 10: 100 -> 110 (+10.0%) significant REGRESSION\n"
+                      "apa 20: 100 -> 101 (+1.0%)\n"
+                      "katt: no baseline\n");
+  REQUIRE(r.regressed());
+  std::remove((std::string(dir) + "/apa").c_str());
+  rmdir(dir);
+}
+
+TEST_CASE("baseline_reporter leaves the format of the stream as it was", "[baseline]")
+{
+  char dir[] = "/tmp/tachymeter_baselineXXXXXX";
+  REQUIRE(mkdtemp(dir) != nullptr);
+  auto base = sample_measurement();
+  {
+    tachymeter::CSV_reporter csv(dir);
+    csv.report({ base }, "apa");
+  }
+  mock_reporter next;
+  REQUIRE_CALL(next, report(_, "apa"));
+  std::ostringstream os;
+  tachymeter::baseline_reporter r(dir, 0.05, next, os);
+  r.report({ base }, "apa");
+  os.str("");
+  os << 1234.5 << ' ' << 0.125;
+  REQUIRE(os.str() == "1234.5 0.125");
+  std::remove((std::string(dir) + "/apa").c_str());
+  rmdir(dir);
+}
+
+TEST_CASE("CSV_reporter writes a column per dimension, which baseline_reporter matches", "[baseline]")
+{
+  char dir[] = "/tmp/tachymeter_baselineXXXXXX";
+  REQUIRE(mkdtemp(dir) != nullptr);
+  auto base = sample_measurement();
+  base.median         = 100;
+  base.median_low     = 98;
+  base.median_high    = 102;
+  base.num_parameters = 2;
+  base.parameters[0]  = 10;
+  base.parameters[1]  = 75;
+  auto other = base;
+  other.parameters[1] = 50;
+  other.median        = 50;
+  std::ostringstream csv_out;
+  {
+    tachymeter::CSV_reporter csv(dir, &csv_out);
+    csv.report({ other, base }, "apa");
+  }
+  REQUIRE(csv_out.str() == "# apa\n"
+                           "#size,size2,lo_q,median,agerage,hi_q,runs,batch,p90,p99,p99.9,max,median_lo,median_hi\n"
+                           "10,50,1,50,2,3,9,1,4,5,5,5,98,102\n"
+                           "10,75,1,100,2,3,9,1,4,5,5,5,98,102\n");
+  tachymeter::result_sequence old;
+  REQUIRE(tachymeter::read_CSV_results(std::string(dir) + "/apa", old));
+  REQUIRE(old.size() == 2U);
+  REQUIRE(old[1].num_parameters == 2U);
+  REQUIRE(old[1].parameters[0] == 10U);
+  REQUIRE(old[1].parameters[1] == 75U);
+
+  mock_reporter next;
+  REQUIRE_CALL(next, report(_, "apa"));
+  std::ostringstream os;
+  tachymeter::baseline_reporter r(dir, 0.05, next, os);
+  r.report({ base }, "apa");
+  REQUIRE(os.str() == "apa 10x75: 100 -> 100 (+0.0%)\n");
+  std::remove((std::string(dir) + "/apa").c_str());
+  rmdir(dir);
+}
+
+TEST_CASE("baseline_reporter reports significant speedups without failing", "[baseline]")
+{
+  char dir[] = "/tmp/tachymeter_baselineXXXXXX";
+  REQUIRE(mkdtemp(dir) != nullptr);
+  auto base = sample_measurement();
+  base.median      = 100;
+  base.median_low  = 98;
+  base.median_high = 102;
+  {
+    tachymeter::CSV_reporter csv(dir);
+    csv.report({ base }, "apa");
+  }
+  mock_reporter next;
+  REQUIRE_CALL(next, report(_, "apa"));
+  std::ostringstream os;
+  tachymeter::baseline_reporter r(dir, 0.05, next, os);
+  auto faster = base;
+  faster.median      = 50;
+  faster.median_low  = 49;
+  faster.median_high = 51;
+  r.report({ faster }, "apa");
+  REQUIRE(os.str() == "apa 10: 100 -> 50 (-50.0%) significant\n");
+  REQUIRE(!r.regressed());
+  std::remove((std::string(dir) + "/apa").c_str());
+  rmdir(dir);
+}
+
+TEST_CASE("benchmark::run with -b flag returns non-zero when a regression exceeds the -t threshold", "[benchmark]")
+{
+  char dir[] = "/tmp/tachymeter_baselineXXXXXX";
+  REQUIRE(mkdtemp(dir) != nullptr);
+  auto base = sample_measurement();
+  base.data_size   = 123;
+  base.median      = 1;
+  base.median_low  = 1;
+  base.median_high = 1;
+  {
+    tachymeter::CSV_reporter csv(dir);
+    csv.report({ base }, "apa");
+  }
+  mock_reporter reporter;
+  ALLOW_CALL(reporter, report(_, "apa"));
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<dummy_test<0>>(tachymeter::seq(123), "apa", 1ms);
+  test_mock m;
+  mock_tests[0] = &m;
+  ALLOW_CALL(m, constr(123U));
+  ALLOW_CALL(m, call(123U))
+  .LR_SIDE_EFFECT(tick += 10);
+
+  char *argv[] = {
+      const_cast<char*>("apa"),
+      const_cast<char*>("-b"),
+      dir,
+      const_cast<char*>("-t"),
+      const_cast<char*>("1000000")
+  };
+  std::ostringstream os;
+  REQUIRE(b.run(5, argv, os) == 0);
+  REQUIRE(os.str().find("significant") != std::string::npos);
+  REQUIRE(os.str().find("REGRESSION") == std::string::npos);
+
+  os.str("");
+  REQUIRE(b.run(3, argv, os) == 1);
+  REQUIRE(os.str().find("REGRESSION") != std::string::npos);
+  std::remove((std::string(dir) + "/apa").c_str());
+  rmdir(dir);
+}
+
+TEST_CASE("sample columns are delta encoded varints that decode to the same values", "[binary]")
+{
+  std::vector<uint64_t> const values{ 100, 101, 99, 99, 5000000, 0,
+                                      ~uint64_t{}, 1 };
+  std::string column;
+  tachymeter::sample_file::encode_column(values, column);
+  REQUIRE(column.size() < values.size() * sizeof(uint64_t));
+  REQUIRE(column.substr(0, 3) == std::string("\xc8\x01\x02", 3));
+
+  std::vector<uint64_t> decoded;
+  auto const first = reinterpret_cast<unsigned char const*>(column.data());
+  REQUIRE(tachymeter::sample_file::decode_column(first,
+                                                 first + column.size(),
+                                                 decoded));
+  REQUIRE(decoded == values);
+}
+
+TEST_CASE("binary_reporter writes the raw samples of each size point to a sample file", "[binary]")
+{
+  char dir[] = "/tmp/tachymeter_samplesXXXXXX";
+  REQUIRE(mkdtemp(dir) != nullptr);
+  mock_reporter next;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(next, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  tachymeter::binary_reporter reporter(dir, &next);
+
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<dummy_test<0>>(tachymeter::seq(3, 4), "apa", 20ms);
+  test_mock m;
+  mock_tests[0] = &m;
+  int extra = 0;
+  ALLOW_CALL(m, constr(_));
+  ALLOW_CALL(m, call(_))
+  .LR_SIDE_EFFECT(tick += extra++ % 3);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  REQUIRE(b.run(1, argv, os) == 0);
+
+  std::vector<tachymeter::raw_samples> points;
+  auto const path = std::string(dir) + "/apa.samples";
+  REQUIRE(tachymeter::sample_file::read(path, points));
+  REQUIRE(points.size() == 2U);
+  REQUIRE(results.size() == 2U);
+  for (std::size_t i = 0; i != 2; ++i)
+  {
+    auto const &p = points[i];
+    REQUIRE(p.data_size == results[i].data_size);
+    REQUIRE(p.batch_size == 1U);
+    REQUIRE(p.durations.size() == results[i].num_runs);
+    REQUIRE(p.counters[0].empty());
+    tachymeter::histogram h;
+    for (auto d : p.durations) h.record(d);
+    REQUIRE(h.at_rank(h.count() / 2) == results[i].median);
+  }
+  std::remove(path.c_str());
+  rmdir(dir);
+}
+
+TEST_CASE("binary_reporter writes the parameters of each point of a product to the sample file", "[binary]")
+{
+  char dir[] = "/tmp/tachymeter_samplesXXXXXX";
+  REQUIRE(mkdtemp(dir) != nullptr);
+  mock_reporter next;
+  REQUIRE_CALL(next, report(_, "apa"));
+  tachymeter::binary_reporter reporter(dir, &next);
+
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<sweep_test>(tachymeter::product(tachymeter::seq(1, 2),
+                                            tachymeter::seq(3, 5)),
+                        "apa",
+                        1ms);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  REQUIRE(b.run(1, argv, os) == 0);
+
+  std::vector<tachymeter::raw_samples> points;
+  auto const path = std::string(dir) + "/apa.samples";
+  REQUIRE(tachymeter::sample_file::read(path, points));
+  REQUIRE(points.size() == 4U);
+  REQUIRE(points[0].parameters == (std::vector<uint64_t>{ 1, 3 }));
+  REQUIRE(points[1].parameters == (std::vector<uint64_t>{ 1, 5 }));
+  REQUIRE(points[2].parameters == (std::vector<uint64_t>{ 2, 3 }));
+  REQUIRE(points[3].parameters == (std::vector<uint64_t>{ 2, 5 }));
+  REQUIRE(points[1].data_size == 1U);
+  std::remove(path.c_str());
+  rmdir(dir);
+}
+
+TEST_CASE("binary_reporter writes no sample file for results reported without raw samples", "[binary]")
+{
+  char dir[] = "/tmp/tachymeter_samplesXXXXXX";
+  REQUIRE(mkdtemp(dir) != nullptr);
+  mock_reporter next;
+  REQUIRE_CALL(next, report(_, "apa"));
+  REQUIRE_CALL(next, report(_, "apa.first"));
+  REQUIRE_CALL(next, report(_, "katt"));
+  tachymeter::binary_reporter reporter(dir, &next);
+
+  tachymeter::raw_samples s;
+  s.data_size = 10;
+  s.batch_size = 1;
+  s.durations = { 1, 2, 3 };
+  reporter.samples(s, "apa");
+  reporter.report({ sample_measurement() }, "apa");
+  reporter.report({ sample_measurement() }, "apa.first");
+  reporter.report({ sample_measurement() }, "katt");
+
+  auto const path = std::string(dir) + "/apa.samples";
+  std::vector<tachymeter::raw_samples> points;
+  REQUIRE(tachymeter::sample_file::read(path, points));
+  REQUIRE(points.size() == 1U);
+  REQUIRE(!std::ifstream(std::string(dir) + "/apa.first.samples"));
+  REQUIRE(!std::ifstream(std::string(dir) + "/katt.samples"));
+  std::remove(path.c_str());
+  rmdir(dir);
+}
+
+TEST_CASE("stream_reporter passes raw samples to the replaying reporter", "[isolation]")
+{
+  std::string buffer;
+  tachymeter::stream_reporter out(buffer, true);
+  REQUIRE(out.wants_samples());
+  tachymeter::raw_samples s;
+  s.data_size  = 10;
+  s.batch_size = 2;
+  s.durations  = { 3, 4, 5 };
+  s.counters[1] = { 7, 8, 9 };
+  s.parameters = { 10, 20 };
+  out.samples(s, "apa");
+
+  class sample_reporter : public tachymeter::reporter
+  {
+  public:
+    void report(tachymeter::result_sequence const&, std::string const&) override {}
+    void samples(tachymeter::raw_samples const &r, std::string const &name) override
+    {
+      got = r;
+      got_name = name;
+    }
+    tachymeter::raw_samples got{ };
+    std::string             got_name;
+  } in;
+  REQUIRE(tachymeter::replay(buffer, in));
+  REQUIRE(in.got_name == "apa");
+  REQUIRE(in.got.data_size == 10U);
+  REQUIRE(in.got.batch_size == 2U);
+  REQUIRE(in.got.durations == s.durations);
+  REQUIRE(in.got.counters[0].empty());
+  REQUIRE(in.got.counters[1] == s.counters[1]);
+  REQUIRE(in.got.parameters == s.parameters);
+}
+
+tachymeter::result_sequence medians_of(double (*f)(double))
+{
+  tachymeter::result_sequence results;
+  for (auto size : tachymeter::powers(tachymeter::seq(1, 2, 5), 10, 10000, 10))
+  {
+    auto m = sample_measurement();
+    m.data_size = size;
+    m.median    = static_cast<uint64_t>(f(double(size)));
+    results.push_back(m);
+  }
+  return results;
+}
+
+TEST_CASE("fit_complexities finds the complexity that best fits the medians", "[complexity]")
+{
+  auto const n_log_n = medians_of([](double n) { return 5 * n * std::log2(n) + 30; });
+  auto const best = tachymeter::best_complexity(tachymeter::fit_complexities(n_log_n));
+  REQUIRE(best.kind == tachymeter::complexity::n_log_n);
+  REQUIRE(best.coefficient == Approx(5.0).epsilon(0.01));
+  REQUIRE(best.error < 0.01);
+
+  auto const linear = medians_of([](double n) { return 3 * n + 50; });
+  REQUIRE(tachymeter::best_complexity(tachymeter::fit_complexities(linear)).kind
+          == tachymeter::complexity::linear);
+
+  auto const fits = tachymeter::fit_complexities(linear);
+  REQUIRE(fits.back().kind == tachymeter::complexity::power_law);
+  REQUIRE(fits.back().exponent == Approx(1.0).epsilon(0.15));
+
+  REQUIRE(tachymeter::fit_complexities({ sample_measurement() }).empty());
+}
+
+TEST_CASE("complexity_reporter fails a job that grows faster than expected", "[complexity]")
+{
+  mock_reporter next;
+  REQUIRE_CALL(next, report(_, "sort"));
+  REQUIRE_CALL(next, report(_, "bad_sort"));
+  REQUIRE_CALL(next, report(_, "other"));
+  std::ostringstream os;
+  tachymeter::complexity_reporter r(next, os);
+  r.expect("sort", tachymeter::complexity::n_log_n);
+  r.expect("bad_sort", tachymeter::complexity::n_log_n);
+
+  r.report(medians_of([](double n) { return 5 * n * std::log2(n); }), "sort");
+  REQUIRE(os.str().find("sort: O(n log n) 5 * n log n") == 0);
+  REQUIRE(os.str().find("sort 1000: 49.8 per element\n") != std::string::npos);
+  REQUIRE(!r.failed());
+
+  os.str("");
+  r.report(medians_of([](double n) { return n * n / 100 + 3 * n * std::log2(n); }),
+           "bad_sort");
+  REQUIRE(os.str().find("bad_sort: O(n^2)") == 0);
+  REQUIRE(os.str().find("expected O(n log n) FAILED\n") != std::string::npos);
+  REQUIRE(r.failed());
+
+  os.str("");
+  r.report(medians_of([](double n) { return n; }), "other");
+  REQUIRE(os.str().empty());
+}
+
+TEST_CASE("benchmark::run returns non-zero when a measurement grows faster than its expected complexity", "[benchmark]")
+{
+  mock_reporter reporter;
+  ALLOW_CALL(reporter, report(_, "apa"));
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  using bench = tachymeter::benchmark<test_clock>;
+  bench b(reporter);
+  bench::options opts{ 1ms };
+  opts.expected_complexity = tachymeter::complexity::linear;
+  b.measure<dummy_test<0>>(tachymeter::powers(1, 64, 2), "apa", opts);
+  test_mock m;
+  mock_tests[0] = &m;
+  ALLOW_CALL(m, constr(_));
+  ALLOW_CALL(m, call(_))
+  .LR_SIDE_EFFECT(tick += int(_1 * _1));
+
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  REQUIRE(b.run(1, argv, os) == 1);
+  REQUIRE(os.str().find("apa: O(n^2)") == 0);
+  REQUIRE(os.str().find("FAILED") != std::string::npos);
+}
+
+TEST_CASE("around_caches samples element counts densely below and above each cache size", "[sequences]")
+{
+  auto s = tachymeter::around_caches<int>({ 32768, 1 << 20 }, 2);
+  std::vector<std::size_t> sizes(s.begin(), s.end());
+  std::vector<std::size_t> expected{ 4096, 6144, 8192, 10240, 12288, 16384,
+                                     131072, 196608, 262144, 327680, 393216,
+                                     524288 };
+  REQUIRE(sizes == expected);
+
+  auto machine = tachymeter::around_caches<double>();
+  REQUIRE(std::is_sorted(machine.begin(), machine.end()));
+  REQUIRE(machine.begin() != machine.end());
+}
+
+TEST_CASE("around_caches can be used as a sub generator", "[sequences]")
+{
+  auto s = tachymeter::seq(tachymeter::around_caches<int>({ 4096 }, 1), 1, 10);
+  std::vector<std::size_t> sizes(s.begin(), s.end());
+  std::vector<std::size_t> expected{ 512, 1024, 1536, 2048,
+                                     5120, 10240, 15360, 20480 };
+  REQUIRE(sizes == expected);
+}
+
+TEST_CASE("refine bisects between sizes where the time per element changes", "[sequences]")
+{
+  auto s = tachymeter::refine(tachymeter::seq(1000, 10000, 100000), 0.2, 0.01, 20);
+  std::vector<std::size_t> sizes;
+  std::size_t size;
+  while (s.next(size))
+  {
+    sizes.push_back(size);
+    auto m = sample_measurement();
+    m.data_size = size;
+    m.median    = size < 3000 ? size : 10 * size;
+    s.result(m);
+  }
+  REQUIRE(sizes.size() < 20U);
+  REQUIRE(sizes[0] == 1000U);
+  REQUIRE(sizes[1] == 10000U);
+  REQUIRE(sizes[2] == 100000U);
+  REQUIRE(sizes[3] == 3162U);
+  std::sort(sizes.begin(), sizes.end());
+  auto const knee = std::lower_bound(sizes.begin(), sizes.end(), 3000U);
+  REQUIRE(double(*knee) <= double(*(knee - 1)) * 1.02);
+  REQUIRE(std::none_of(sizes.begin(), sizes.end(),
+                       [](std::size_t n) { return n > 10000 && n < 100000; }));
+}
+
+TEST_CASE("refine stops at max sizes", "[sequences]")
+{
+  auto s = tachymeter::refine(tachymeter::seq(1, 1000000), 0.2, 0.0, 5);
+  std::size_t size;
+  std::size_t count = 0;
+  while (s.next(size))
+  {
+    ++count;
+    auto m = sample_measurement();
+    m.data_size = size;
+    m.median    = size * size;
+    s.result(m);
+  }
+  REQUIRE(count == 5U);
+}
+
+TEST_CASE("benchmark::run measures the sizes of an adaptive sequence and reports them in order", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<dummy_test<0>>(tachymeter::refine(tachymeter::seq(10, 40), 0.2, 0.0, 3),
+                           "apa",
+                           1ms);
+  test_mock m;
+  mock_tests[0] = &m;
+  ALLOW_CALL(m, constr(_));
+  ALLOW_CALL(m, call(_))
+  .LR_SIDE_EFFECT(tick += int(_1 * _1));
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(results.size() == 3U);
+  REQUIRE(results[0].data_size == 10U);
+  REQUIRE(results[1].data_size == 20U);
+  REQUIRE(results[2].data_size == 40U);
+}
+
+TEST_CASE("benchmark::run reports the sizes of other sequences in the order given", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<dummy_test<0>>(tachymeter::seq(5, 1, 3), "apa", 1ms);
+  test_mock m;
+  mock_tests[0] = &m;
+  ALLOW_CALL(m, constr(_));
+  ALLOW_CALL(m, call(_));
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(results.size() == 3U);
+  REQUIRE(results[0].data_size == 5U);
+  REQUIRE(results[1].data_size == 1U);
+  REQUIRE(results[2].data_size == 3U);
+}
+
+TEST_CASE("product gives every combination with the last dimension varying fastest", "[sequences]")
+{
+  auto s = tachymeter::product(tachymeter::seq(1, 2),
+                               tachymeter::powers(10, 100, 10),
+                               tachymeter::seq(7));
+  std::vector<std::array<std::size_t, 3>> values(s.begin(), s.end());
+  std::vector<std::array<std::size_t, 3>> expected{
+    {{ 1, 10, 7 }}, {{ 1, 100, 7 }}, {{ 2, 10, 7 }}, {{ 2, 100, 7 }}
+  };
+  REQUIRE(values == expected);
+}
+
+TEST_CASE("zip pairs the values of sequences up to the shortest", "[sequences]")
+{
+  auto s = tachymeter::zip(tachymeter::seq(1, 2, 3), tachymeter::seq(5, 6));
+  std::vector<std::array<std::size_t, 2>> values(s.begin(), s.end());
+  std::vector<std::array<std::size_t, 2>> expected{ {{ 1, 5 }}, {{ 2, 6 }} };
+  REQUIRE(values == expected);
+}
+
+TEST_CASE("benchmark::run passes the parameters of multi-dimensional sequences to the setup and reports them", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<sweep_test>(tachymeter::product(tachymeter::seq(1, 2),
+                                            tachymeter::seq(3, 5)),
+                        "apa",
+                        1ms);
+  sweep_test::constructed.clear();
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(sweep_test::constructed.front() == (sweep_test::parameters{{ 1, 3 }}));
+  REQUIRE(sweep_test::constructed.back() == (sweep_test::parameters{{ 2, 5 }}));
+  REQUIRE(results.size() == 4U);
+  REQUIRE(results[1].data_size == 1U);
+  REQUIRE(results[1].num_parameters == 2U);
+  REQUIRE(results[1].parameters[0] == 1U);
+  REQUIRE(results[1].parameters[1] == 5U);
+}
+
+TEST_CASE("benchmark::measure with a type list adds a job per type named after the type", "[benchmark]")
+{
+  mock_reporter reporter;
+  trompeloeil::sequence report_seq;
+  REQUIRE_CALL(reporter, report(_, "apa<char>"))
+  .IN_SEQUENCE(report_seq);
+  REQUIRE_CALL(reporter, report(_, "apa<double>"))
+  .IN_SEQUENCE(report_seq);
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<typed_test, tachymeter::type_list<char, double>>(tachymeter::seq(3),
+                                                            "apa",
+                                                            1ms);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(typed_test<char>::element_bytes.front() == 3U);
+  REQUIRE(typed_test<double>::element_bytes.front() == 3U * sizeof(double));
+}
+
+TEST_CASE("benchmark::run constructs setups with reset once per size and resets them before every further call", "[benchmark]")
+{
+  reset_test::constructions = 0;
+  reset_test::resets = 0;
+  reset_test::calls = 0;
+  mock_reporter reporter;
+  REQUIRE_CALL(reporter, report(_, "apa"));
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<reset_test>(tachymeter::seq(10, 20), "apa", 20ms);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(reset_test::constructions == 2);
+  REQUIRE(reset_test::calls > 18);
+  REQUIRE(reset_test::resets == reset_test::calls - 2);
+}
+
+TEST_CASE("benchmark::run constructs setups with copy_prototype once per size and copies them for every call", "[benchmark]")
+{
+  prototype_test::constructions = 0;
+  prototype_test::copies = 0;
+  prototype_test::calls = 0;
+  mock_reporter reporter;
+  REQUIRE_CALL(reporter, report(_, "apa"));
+  test_clock clock;
+  int tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<prototype_test>(tachymeter::seq(10, 20), "apa", 20ms);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(prototype_test::constructions == 2);
+  REQUIRE(prototype_test::calls > 18);
+  REQUIRE(prototype_test::copies == prototype_test::calls);
+}
+
+TEST_CASE("benchmark::compare runs both setups on the same seeds and reports the speedup of the second", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence slow;
+  tachymeter::result_sequence fast;
+  trompeloeil::sequence report_seq;
+  REQUIRE_CALL(reporter, report(_, "slow"))
+  .IN_SEQUENCE(report_seq)
+  .LR_SIDE_EFFECT(slow = _1);
+  REQUIRE_CALL(reporter, report(_, "fast"))
+  .IN_SEQUENCE(report_seq)
+  .LR_SIDE_EFFECT(fast = _1);
+  test_clock clock;
+  int &tick = compare_ticks;
+  tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.compare<compare_test<12>, compare_test<4>>(tachymeter::seq(10, 20),
+                                              "slow",
+                                              "fast",
+                                              100ms);
+  char* argv[] = { const_cast<char*>("apa"), const_cast<char*>("slow vs fast") };
+  std::ostringstream os;
+  REQUIRE(b.run(2, argv, os) == 0);
+  REQUIRE(compare_test<12>::seeds.size() >= 18U);
+  REQUIRE(compare_test<12>::seeds == compare_test<4>::seeds);
+  REQUIRE(slow.size() == 2U);
+  REQUIRE(fast.size() == 2U);
+  REQUIRE(!slow[0].has_speedup);
+  REQUIRE(fast[1].data_size == 20U);
+  REQUIRE(fast[1].has_speedup);
+  REQUIRE(fast[1].median < slow[1].median);
+  REQUIRE(fast[1].speedup == Approx(double(slow[1].median) / double(fast[1].median)));
+  REQUIRE(fast[1].speedup_low <= fast[1].speedup);
+  REQUIRE(fast[1].speedup_high >= fast[1].speedup);
+}
+
+TEST_CASE("benchmark::compare with precision target counts max runs in calls of each setup", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence noisy;
+  tachymeter::result_sequence fixed;
+  REQUIRE_CALL(reporter, report(_, "noisy"))
+  .LR_SIDE_EFFECT(noisy = _1);
+  REQUIRE_CALL(reporter, report(_, "fixed"))
+  .LR_SIDE_EFFECT(fixed = _1);
+  test_clock clock;
+  int &tick = compare_ticks;
+  tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  tachymeter::benchmark<test_clock>::options opts{ 1ms };
+  opts.precision = 0.01;
+  opts.max_time = 10s;
+  opts.max_runs = 22;
+  b.compare<noisy_compare_test, compare_test<4>>(tachymeter::seq(10),
+                                                 "noisy",
+                                                 "fixed",
+                                                 opts);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  REQUIRE(b.run(1, argv, os) == 0);
+  REQUIRE(noisy.size() == 1U);
+  REQUIRE(fixed.size() == 1U);
+  REQUIRE(noisy[0].num_runs == 22U);
+  REQUIRE(fixed[0].num_runs == 22U);
+  REQUIRE(fixed[0].speedup_low < fixed[0].speedup_high);
+}
+
+TEST_CASE("benchmark::run with -a flag fits the results of both compared setups", "[benchmark]")
+{
+  mock_reporter reporter;
+  ALLOW_CALL(reporter, report(_, "slow"));
+  ALLOW_CALL(reporter, report(_, "fast"));
+  test_clock clock;
+  int &tick = compare_ticks;
+  tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.compare<compare_test<12>, compare_test<4>>(tachymeter::powers(1, 64, 2),
+                                              "slow",
+                                              "fast",
+                                              1ms);
+  char* argv[] = { const_cast<char*>("apa"), const_cast<char*>("-a") };
+  std::ostringstream os;
+  REQUIRE(b.run(2, argv, os) == 0);
+  REQUIRE(os.str().find("slow: O(1)") != std::string::npos);
+  REQUIRE(os.str().find("fast: O(1)") != std::string::npos);
+}
+
+TEST_CASE("CSV_reporter writes speedup columns for compared measurements", "[reporter]")
+{
+  auto m = sample_measurement();
+  m.has_speedup  = true;
+  m.speedup      = 1.5;
+  m.speedup_low  = 1.25;
+  m.speedup_high = 2;
+  std::ostringstream os;
+  tachymeter::CSV_reporter reporter(nullptr, &os);
+  reporter.report({ m }, "apa");
+  REQUIRE(os.str() == "# apa\n"
+                      "#size,lo_q,median,agerage,hi_q,runs,batch,p90,p99,p99.9,max,"
+                      "median_lo,median_hi,speedup,speedup_lo,speedup_hi\n"
+                      "10,1,2,2,3,9,1,4,5,5,5,1,3,1.5,1.25,2\n");
+}
+
+TEST_CASE("benchmark::run reports the phases timed with laps after the whole calls", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence whole;
+  tachymeter::result_sequence first;
+  tachymeter::result_sequence second;
+  trompeloeil::sequence report_seq;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .IN_SEQUENCE(report_seq)
+  .LR_SIDE_EFFECT(whole = _1);
+  REQUIRE_CALL(reporter, report(_, "apa.first"))
+  .IN_SEQUENCE(report_seq)
+  .LR_SIDE_EFFECT(first = _1);
+  REQUIRE_CALL(reporter, report(_, "apa.second"))
+  .IN_SEQUENCE(report_seq)
+  .LR_SIDE_EFFECT(second = _1);
+  test_clock clock;
+  int &tick = lap_test::ticks;
+  tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  tachymeter::benchmark<test_clock> b(reporter);
+  b.measure<lap_test>(tachymeter::seq(10, 20), "apa", 10ms);
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(first.size() == 2U);
+  REQUIRE(second.size() == 2U);
+  REQUIRE(second[1].data_size == 20U);
+  REQUIRE(second[1].num_runs == whole[1].num_runs);
+  REQUIRE(first[1].median == 2U);
+  REQUIRE(second[1].median == 6U);
+  // The clock reads of the laps are not part of the whole call.
+  auto const phases = first[1].median + second[1].median;
+  REQUIRE(phases + 1 >= whole[1].median);
+  REQUIRE(phases <= whole[1].median + 1);
+}
+
+TEST_CASE("benchmark::run with batch window times setups with laps one call at a time", "[benchmark]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence whole;
+  tachymeter::result_sequence first;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(whole = _1);
+  REQUIRE_CALL(reporter, report(_, "apa.first"))
+  .LR_SIDE_EFFECT(first = _1);
+  REQUIRE_CALL(reporter, report(_, "apa.second"));
+  test_clock clock;
+  int &tick = lap_test::ticks;
+  tick = 0;
+  ALLOW_CALL(clock, mock_now())
+  .LR_RETURN(std::chrono::milliseconds(tick++));
+  using bench = tachymeter::benchmark<test_clock>;
+  bench b(reporter);
+  b.measure<lap_test>(tachymeter::seq(10), "apa", bench::options{ 10ms, 100ms });
+  char* argv[] = { const_cast<char*>("apa")};
+  std::ostringstream os;
+  b.run(1, argv, os);
+  REQUIRE(whole.size() == 1U);
+  REQUIRE(whole[0].batch_size == 1U);
+  REQUIRE(first.size() == 1U);
+  REQUIRE(first[0].median == 2U);
+}
+
+TEST_CASE("probe_collector reports the latencies recorded by all threads since the collection before", "[probe]")
+{
+  mock_reporter reporter;
+  std::vector<tachymeter::result_sequence> reports;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .TIMES(2)
+  .LR_SIDE_EFFECT(reports.push_back(_1));
+  tachymeter::probe_site site("apa");
+  tachymeter::probe_collector collector(reporter);
+  collector.watch(site);
+  std::thread t([&] { for (uint64_t i = 1; i <= 100; ++i) site.record(i); });
+  for (uint64_t i = 101; i <= 200; ++i) site.record(i);
+  t.join();
+  collector.collect();
+  collector.collect();
+  site.record(1000);
+  collector.collect();
+  REQUIRE(reports[0].size() == 1U);
+  REQUIRE(reports[0][0].data_size == 1U);
+  REQUIRE(reports[0][0].num_runs == 200U);
+  REQUIRE(reports[0][0].median == 101U);
+  REQUIRE(reports[0][0].maximum == 200U);
+  REQUIRE(reports[1][0].data_size == 3U);
+  REQUIRE(reports[1][0].num_runs == 1U);
+  REQUIRE(reports[1][0].median >= 1000U);
+  REQUIRE(reports[1][0].median < 1008U);
+}
+
+TEST_CASE("probe records the clock ticks from construction to destruction", "[probe]")
+{
+  mock_reporter reporter;
+  tachymeter::result_sequence results;
+  REQUIRE_CALL(reporter, report(_, "apa"))
+  .LR_SIDE_EFFECT(results = _1);
+  test_clock clock;
+  trompeloeil::sequence seq;
+  REQUIRE_CALL(clock, mock_now())
+  .IN_SEQUENCE(seq)
+  .RETURN(std::chrono::milliseconds(3));
+  REQUIRE_CALL(clock, mock_now())
+  .IN_SEQUENCE(seq)
+  .RETURN(std::chrono::milliseconds(10));
+  tachymeter::probe_site site("apa");
+  tachymeter::probe_collector collector(reporter);
+  collector.watch(site);
+  {
+    tachymeter::probe<test_clock> p(site);
+  }
+  collector.collect();
+  REQUIRE(results.size() == 1U);
+  REQUIRE(results[0].median == 7U);
+}